@@ -175,7 +175,7 @@ LUA_API int lua_iscfunction(lua_State *L, int idx) {
 LUA_API int lua_isnumber(lua_State *L, int idx) {
     TValue n;
     const TValue *o = index2adr(L, idx);
-    return tonumber(o, &n);
+    return tonumber(L, o, &n);
 }
 
 LUA_API int lua_isstring(lua_State *L, int idx) {
@@ -216,7 +216,7 @@ LUA_API int lua_lessthan(lua_State *L, int index1, int index2) {
 LUA_API lua_Number lua_tonumber(lua_State *L, int idx) {
     TValue n;
     const TValue *o = index2adr(L, idx);
-    if (tonumber(o, &n))
+    if (tonumber(L, o, &n))
         return nvalue(o);
     else
         return 0;
@@ -225,8 +225,12 @@ LUA_API lua_Number lua_tonumber(lua_State *L, int idx) {
 LUA_API lua_Integer lua_tointeger(lua_State *L, int idx) {
     TValue n;
     const TValue *o = index2adr(L, idx);
-    if (tonumber(o, &n)) {
+    if (tonumber(L, o, &n)) {
         lua_Integer res;
+#if LUA_INTSUBTYPE
+        if (ttisint(o))
+            return cast(lua_Integer, ivalue(o));
+#endif
         lua_Number num = nvalue(o);
         lua_number2integer(res, num);
         return res;
@@ -253,7 +257,7 @@ LUA_API const char *lua_tolstring(lua_State *L, int idx, size_t *len) {
     }
     if (len != nullptr)
         *len = tsvalue(o)->len;
-    return svalue(o);
+    return luaS_flatten(L, rawtsvalue(o));
 }
 
 LUA_API size_t lua_objlen(lua_State *L, int idx) {
@@ -328,7 +332,7 @@ LUA_API void lua_pushnumber(lua_State *L, lua_Number n) {
 }
 
 LUA_API void lua_pushinteger(lua_State *L, lua_Integer n) {
-    setnvalue(L->top, cast_num(n));
+    setivalue(L->top, n);
     api_incr_top(L);
 }
 
@@ -495,16 +499,15 @@ LUA_API void lua_setfield(lua_State *L, int idx, const char *k) {
 LUA_API void lua_rawset(lua_State *L, int idx) {
     StkId t = index2adr(L, idx);
 
-    setobj2t(L, luaH_set(L, hvalue(t), L->top - 2), L->top - 1);
-    luaC_barriert(L, hvalue(t), L->top - 1);
+    luaH_setobj(L, hvalue(t), L->top - 2, L->top - 1);
     L->top -= 2;
 }
 
 LUA_API void lua_rawseti(lua_State *L, int idx, int n) {
     StkId o = index2adr(L, idx);
-
-    setobj2t(L, luaH_setnum(L, hvalue(o), n), L->top - 1);
-    luaC_barriert(L, hvalue(o), L->top - 1);
+    TValue k;
+    setivalue(&k, n);
+    luaH_setobj(L, hvalue(o), &k, L->top - 1);
     L->top--;
 }
 
@@ -519,6 +522,7 @@ LUA_API int lua_setmetatable(lua_State *L, int objindex) {
     }
     switch (ttype(obj)) {
     case LUA_TTABLE: {
+        luaT_tablewrite(G(L), hvalue(obj));
         hvalue(obj)->metatable = mt;
         if (mt)
             luaC_objbarriert(L, hvalue(obj), mt);
@@ -737,6 +741,37 @@ LUA_API int lua_next(lua_State *L, int idx) {
     return more;
 }
 
+LUA_API void lua_clonetable(lua_State *L, int idx) {
+    luaC_checkGC(L);
+    StkId t = index2adr(L, idx);
+    sethvalue(L, L->top, luaH_clone(L, hvalue(t)));
+    api_incr_top(L);
+}
+
+LUA_API void lua_cleartable(lua_State *L, int idx) {
+    StkId t = index2adr(L, idx);
+    luaH_clear(L, hvalue(t));
+}
+
+/*
+** how well the keys of a table spread over its hash part (see
+** `luaH_hashstats')
+*/
+LUA_API void lua_hashstats(lua_State *L, int idx, int *nkeys, int *probes,
+                           int *longest) {
+    StkId t = index2adr(L, idx);
+    *nkeys = *probes = *longest = 0;
+    luaH_hashstats(hvalue(t), nkeys, probes, longest);
+}
+
+/*
+** declares `nextf' as the function `next' of the base library, so that
+** generic for loops over it need not call it
+*/
+void luaA_setnextf(lua_State *L, lua_CFunction nextf) {
+    G(L)->nextf = nextf;
+}
+
 LUA_API void lua_concat(lua_State *L, int n) {
     if (n >= 2) {
         luaC_checkGC(L);
@@ -749,6 +784,31 @@ LUA_API void lua_concat(lua_State *L, int n) {
     /* else n == 1; nothing to do */
 }
 
+/*
+** growable buffers: `lua_newbuffer' pushes a string whose characters are
+** written in place; `lua_closebuffer' fixes its length, after which it is
+** an ordinary string
+*/
+LUA_API char *lua_newbuffer(lua_State *L, size_t size) {
+    luaC_checkGC(L);
+    TString *ts = luaS_newbuf(L, size);
+    setsvalue2s(L, L->top, ts);
+    api_incr_top(L);
+    return cast(char *, getstr(ts));
+}
+
+LUA_API char *lua_growbuffer(lua_State *L, int idx, size_t size) {
+    StkId o = index2adr(L, idx);
+    api_check(L, o->isstring() && isinbuf(rawtsvalue(o)));
+    return luaS_growbuf(L, rawtsvalue(o), size);
+}
+
+LUA_API void lua_closebuffer(lua_State *L, int idx, size_t len) {
+    StkId o = index2adr(L, idx);
+    api_check(L, o->isstring() && isinbuf(rawtsvalue(o)));
+    setsvalue(L, o, luaS_closebuf(L, rawtsvalue(o), len));
+}
+
 LUA_API void *lua_newuserdata(lua_State *L, size_t size) {
     luaC_checkGC(L);
     Udata *u = luaS_newudata(L, size, getcurrenv(L));
@@ -4,5 +4,6 @@
 #include "lobject.h"
 
 LUAI_FUNC void luaA_pushobject(lua_State *L, const TValue *o);
+LUAI_FUNC void luaA_setnextf(lua_State *L, lua_CFunction nextf);
 
 #endif
@@ -275,50 +275,45 @@ LUALIB_API const char *luaL_findtable(lua_State *L, int idx, const char *fname,
 ** =======================================================
 */
 
-#define bufflen(B) ((B)->p - (B)->buffer)
-#define bufffree(B) ((size_t)(LUAL_BUFFERSIZE - bufflen(B)))
-
-#define LIMIT (LUA_MINSTACK / 2)
-
-static int emptybuffer(luaL_Buffer *B) {
-    size_t l = bufflen(B);
-    if (l == 0)
-        return 0; /* put nothing on stack */
-    else {
-        lua_pushlstring(B->L, B->buffer, l);
-        B->p = B->buffer;
-        B->lvl++;
-        return 1;
-    }
-}
+#define bufflen(B) ((B)->p - (B)->b)
+#define bufffree(B) ((size_t)((B)->size - bufflen(B)))
 
-static void adjuststack(luaL_Buffer *B) {
-    if (B->lvl > 1) {
+/*
+** makes room for `l' more characters. When `buffer' is full they move to
+** a block that doubles as needed, the characters of a string pushed by
+** `lua_newbuffer'; `idx' is where that string is in the stack.
+*/
+static char *prepbuffsize(luaL_Buffer *B, size_t l, int idx) {
+    if (bufffree(B) < l) {
         lua_State *L = B->L;
-        int toget = 1; /* number of levels to concat */
-        size_t toplen = lua_strlen(L, -1);
-        do {
-            size_t l = lua_strlen(L, -(toget + 1));
-            if (B->lvl - toget + 1 >= LIMIT || toplen > l) {
-                toplen += l;
-                toget++;
-            } else
-                break;
-        } while (toget < B->lvl);
-        lua_concat(L, toget);
-        B->lvl = B->lvl - toget + 1;
+        size_t n = bufflen(B);
+        size_t newsize = B->size * 2;
+        if (l > ~(size_t)0 / 2 - n)
+            luaL_error(L, "buffer too large");
+        if (newsize - n < l) /* doubling is not enough? */
+            newsize = n + l;
+        char *b;
+        if (B->b == B->buffer) { /* first time? */
+            b = lua_newbuffer(L, newsize);
+            memcpy(b, B->buffer, n);
+            if (idx != -1)
+                lua_insert(L, idx);
+        } else
+            b = lua_growbuffer(L, idx, newsize);
+        B->b = b;
+        B->p = b + n;
+        B->size = newsize;
     }
+    return B->p;
 }
 
 LUALIB_API char *luaL_prepbuffer(luaL_Buffer *B) {
-    if (emptybuffer(B))
-        adjuststack(B);
-    return B->buffer;
+    return prepbuffsize(B, LUAL_BUFFERSIZE, -1);
 }
 
 LUALIB_API void luaL_addlstring(luaL_Buffer *B, const char *s, size_t l) {
-    while (l--)
-        luaL_addchar(B, *s++);
+    memcpy(prepbuffsize(B, l, -1), s, l);
+    luaL_addsize(B, l);
 }
 
 LUALIB_API void luaL_addstring(luaL_Buffer *B, const char *s) {
@@ -326,31 +321,25 @@ LUALIB_API void luaL_addstring(luaL_Buffer *B, const char *s) {
 }
 
 LUALIB_API void luaL_pushresult(luaL_Buffer *B) {
-    emptybuffer(B);
-    lua_concat(B->L, B->lvl);
-    B->lvl = 1;
+    if (B->b == B->buffer)
+        lua_pushlstring(B->L, B->buffer, bufflen(B));
+    else /* the string takes the block as it is */
+        lua_closebuffer(B->L, -1, bufflen(B));
 }
 
 LUALIB_API void luaL_addvalue(luaL_Buffer *B) {
     lua_State *L = B->L;
     size_t vl;
     const char *s = lua_tolstring(L, -1, &vl);
-    if (vl <= bufffree(B)) { /* fit into buffer? */
-        memcpy(B->p, s, vl); /* put it there */
-        B->p += vl;
-        lua_pop(L, 1); /* remove from stack */
-    } else {
-        if (emptybuffer(B))
-            lua_insert(L, -2); /* put buffer before new value */
-        B->lvl++;              /* add new value into B stack */
-        adjuststack(B);
-    }
+    memcpy(prepbuffsize(B, vl, -2), s, vl); /* block goes below the value */
+    luaL_addsize(B, vl);
+    lua_pop(L, 1); /* remove value */
 }
 
 LUALIB_API void luaL_buffinit(lua_State *L, luaL_Buffer *B) {
     B->L = L;
-    B->p = B->buffer;
-    B->lvl = 0;
+    B->p = B->b = B->buffer;
+    B->size = LUAL_BUFFERSIZE;
 }
 
 /* }====================================================== */
@@ -98,14 +98,15 @@ LUALIB_API const char *(luaL_findtable)(lua_State *L, int idx,
 */
 
 struct luaL_Buffer {
-    char *p; /* current position in buffer */
-    int lvl; /* number of strings in the stack (level) */
+    char *p;     /* current position in buffer */
+    char *b;     /* `buffer', or the block of a string in the stack */
+    size_t size; /* size of `b' */
     lua_State *L;
     char buffer[LUAL_BUFFERSIZE];
 };
 
 #define luaL_addchar(B, c)                                                     \
-    ((void)((B)->p < ((B)->buffer + LUAL_BUFFERSIZE) || luaL_prepbuffer(B)),   \
+    ((void)((B)->p < ((B)->b + (B)->size) || luaL_prepbuffer(B)),              \
      (*(B)->p++ = (char)(c)))
 
 /* compatibility only */
@@ -8,6 +8,7 @@
 
 #include "lua.h"
 
+#include "lapi.h"
 #include "lauxlib.h"
 #include "lualib.h"
 
@@ -43,7 +44,10 @@ static int luaB_tonumber(lua_State *L) {
     int base = luaL_optint(L, 2, 10);
     if (base == 10) { /* standard conversion */
         luaL_checkany(L, 1);
-        if (lua_isnumber(L, 1)) {
+        if (lua_type(L, 1) == LUA_TNUMBER) {
+            lua_settop(L, 1); /* keep the number as it is */
+            return 1;
+        } else if (lua_isnumber(L, 1)) {
             lua_pushnumber(L, lua_tonumber(L, 1));
             return 1;
         }
@@ -563,6 +567,7 @@ static void base_open(lua_State *L) {
     /* `ipairs' and `pairs' need auxiliary functions as upvalues */
     auxopen(L, "ipairs", luaB_ipairs, ipairsaux);
     auxopen(L, "pairs", luaB_pairs, luaB_next);
+    luaA_setnextf(L, luaB_next); /* let loops over `next' skip the call */
     /* `newproxy' needs a weaktable as upvalue */
     lua_createtable(L, 0, 1); /* new table `w' */
     lua_pushvalue(L, -1);     /* `w' will be its own metatable */
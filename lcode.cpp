@@ -18,7 +18,12 @@
 #define hasjumps(e) ((e)->t != (e)->f)
 
 static int isnumeral(expdesc *e) {
-    return (e->k == VKNUM && e->t == NO_JUMP && e->f == NO_JUMP);
+    return ((e->k == VKNUM || e->k == VKINT) && e->t == NO_JUMP &&
+            e->f == NO_JUMP);
+}
+
+static lua_Number numeralvalue(expdesc *e) {
+    return (e->k == VKINT) ? cast_num(e->u.ival) : e->u.nval;
 }
 
 void luaK_nil(FuncState *fs, int from, int n) {
@@ -195,7 +200,8 @@ static int addk(FuncState *fs, TValue *k, TValue *v) {
     TValue *idx = luaH_set(L, fs->h, k);
     Proto *f = fs->f;
     int oldsize = f->sizek;
-    if (idx->isnumber()) {
+    /* 1 and 1.0 are the same key but must stay different constants */
+    if (idx->isnumber() && rawtt(&f->k[cast_int(nvalue(idx))]) == rawtt(v)) {
         return cast_int(nvalue(idx));
     } else { /* constant not found; create a new entry */
         setnvalue(idx, cast_num(fs->nk));
@@ -221,6 +227,12 @@ int luaK_numberK(FuncState *fs, lua_Number r) {
     return addk(fs, &o, &o);
 }
 
+int luaK_intK(FuncState *fs, l_int64 i) {
+    TValue o;
+    setivalue(&o, i);
+    return addk(fs, &o, &o);
+}
+
 static int boolK(FuncState *fs, int b) {
     TValue o;
     setbvalue(&o, b);
@@ -313,6 +325,10 @@ static void discharge2reg(FuncState *fs, expdesc *e, int reg) {
         luaK_codeABx(fs, OP_LOADK, reg, luaK_numberK(fs, e->u.nval));
         break;
     }
+    case VKINT: {
+        luaK_codeABx(fs, OP_LOADK, reg, luaK_intK(fs, e->u.ival));
+        break;
+    }
     case VRELOCABLE: {
         Instruction *pc = &getcode(fs, e);
         SETARG_A(*pc, reg);
@@ -393,12 +409,14 @@ int luaK_exp2RK(FuncState *fs, expdesc *e) {
     luaK_exp2val(fs, e);
     switch (e->k) {
     case VKNUM:
+    case VKINT:
     case VTRUE:
     case VFALSE:
     case VNIL: {
         if (fs->nk <= MAXINDEXRK) { /* constant fit in RK operand? */
             e->u.s.info = (e->k == VNIL)    ? nilK(fs)
                           : (e->k == VKNUM) ? luaK_numberK(fs, e->u.nval)
+                          : (e->k == VKINT) ? luaK_intK(fs, e->u.ival)
                                             : boolK(fs, (e->k == VTRUE));
             e->k = VK;
             return RKASK(e->u.s.info);
@@ -485,6 +503,7 @@ void luaK_goiftrue(FuncState *fs, expdesc *e) {
     switch (e->k) {
     case VK:
     case VKNUM:
+    case VKINT:
     case VTRUE: {
         pc = NO_JUMP; /* always true; do nothing */
         break;
@@ -545,6 +564,7 @@ static void codenot(FuncState *fs, expdesc *e) {
     }
     case VK:
     case VKNUM:
+    case VKINT:
     case VTRUE: {
         e->k = VFALSE;
         break;
@@ -581,12 +601,43 @@ void luaK_indexed(FuncState *fs, expdesc *t, expdesc *k) {
     t->k = VINDEXED;
 }
 
+/* fold integer operands when the result is an exact integer */
+static int intfolding(OpCode op, expdesc *e1, expdesc *e2) {
+    l_int64 v1 = e1->u.ival, v2 = e2->u.ival, r;
+    int ok;
+    switch (op) {
+    case OP_ADD:
+        ok = luaO_intadd(v1, v2, &r);
+        break;
+    case OP_SUB:
+        ok = luaO_intsub(v1, v2, &r);
+        break;
+    case OP_MUL:
+        ok = luaO_intmul(v1, v2, &r);
+        break;
+    case OP_MOD:
+        ok = luaO_intmod(v1, v2, &r);
+        break;
+    case OP_UNM:
+        ok = luaO_intunm(v1, &r);
+        break;
+    default:
+        ok = 0;
+        break;
+    }
+    if (ok)
+        e1->u.ival = r;
+    return ok;
+}
+
 static int constfolding(OpCode op, expdesc *e1, expdesc *e2) {
     lua_Number v1, v2, r;
     if (!isnumeral(e1) || !isnumeral(e2))
         return 0;
-    v1 = e1->u.nval;
-    v2 = e2->u.nval;
+    if (e1->k == VKINT && e2->k == VKINT && intfolding(op, e1, e2))
+        return 1;
+    v1 = numeralvalue(e1);
+    v2 = numeralvalue(e2);
     switch (op) {
     case OP_ADD:
         r = luai_numadd(v1, v2);
@@ -621,6 +672,7 @@ static int constfolding(OpCode op, expdesc *e1, expdesc *e2) {
     }
     if (luai_numisnan(r))
         return 0; /* do not attempt to produce NaN */
+    e1->k = VKNUM;
     e1->u.nval = r;
     return 1;
 }
@@ -658,8 +710,8 @@ static void codecomp(FuncState *fs, OpCode op, int cond, expdesc *e1,
 void luaK_prefix(FuncState *fs, UnOpr op, expdesc *e) {
     expdesc e2;
     e2.t = e2.f = NO_JUMP;
-    e2.k = VKNUM;
-    e2.u.nval = 0;
+    e2.k = VKINT; /* so that `-' keeps integer operands exact */
+    e2.u.ival = 0;
     switch (op) {
     case OPR_MINUS: {
         if (e->k == VK)
@@ -814,3 +866,49 @@ void luaK_setlist(FuncState *fs, int base, int nelems, int tostore) {
     }
     fs->freereg = base + 1; /* free registers with list values */
 }
+
+/*
+** pairs of opcodes that run as one superinstruction, picked from an
+** opcode-pair histogram of the interpreter (comparisons and tests already
+** execute their jump themselves). No opcode here is quickened by the VM,
+** so a pair stays valid for the life of the code.
+*/
+static const struct {
+    lu_byte first, second, fused;
+} fusedpairs[] = {
+    {OP_GETTABLE, OP_GETTABLE, OP_GETTABLE_GETTABLE},
+    {OP_GETTABLE, OP_CALL, OP_GETTABLE_CALL},
+    {OP_GETGLOBAL, OP_GETTABLE, OP_GETGLOBAL_GETTABLE},
+    {OP_SETTABLE, OP_FORLOOP, OP_SETTABLE_FORLOOP},
+    {OP_SELF, OP_CALL, OP_SELF_CALL},
+    {OP_MOVE, OP_CALL, OP_MOVE_CALL},
+};
+
+/*
+** rewrite the first instruction of each pair of a finished function into
+** its superinstruction, which dispatches straight to the second one; the
+** second instruction is left alone, so jumps to it and debug information
+** are not affected
+*/
+void luaK_fuse(Proto *f) {
+    for (int pc = 0; pc + 1 < f->sizecode; pc++) {
+        Instruction i = f->code[pc];
+        OpCode first = GET_OPCODE(i);
+        if (first == OP_CLOSURE) { /* skip upvalue pseudo-instructions */
+            pc += f->p[GETARG_Bx(i)]->nups;
+            continue;
+        }
+        if (first == OP_SETLIST && GETARG_C(i) == 0) { /* skip its count */
+            pc++;
+            continue;
+        }
+        OpCode second = GET_OPCODE(f->code[pc + 1]);
+        for (const auto &fp : fusedpairs) {
+            if (fp.first == first && fp.second == second) {
+                SET_OPCODE(f->code[pc], fp.fused);
+                pc++; /* the second one does not start another pair */
+                break;
+            }
+        }
+    }
+}
@@ -52,6 +52,7 @@ LUAI_FUNC void luaK_reserveregs(FuncState *fs, int n);
 LUAI_FUNC void luaK_checkstack(FuncState *fs, int n);
 LUAI_FUNC int luaK_stringK(FuncState *fs, TString *s);
 LUAI_FUNC int luaK_numberK(FuncState *fs, lua_Number r);
+LUAI_FUNC int luaK_intK(FuncState *fs, l_int64 i);
 LUAI_FUNC void luaK_dischargevars(FuncState *fs, expdesc *e);
 LUAI_FUNC int luaK_exp2anyreg(FuncState *fs, expdesc *e);
 LUAI_FUNC void luaK_exp2nextreg(FuncState *fs, expdesc *e);
@@ -73,5 +74,6 @@ LUAI_FUNC void luaK_prefix(FuncState *fs, UnOpr op, expdesc *v);
 LUAI_FUNC void luaK_infix(FuncState *fs, BinOpr op, expdesc *v);
 LUAI_FUNC void luaK_posfix(FuncState *fs, BinOpr op, expdesc *v1, expdesc *v2);
 LUAI_FUNC void luaK_setlist(FuncState *fs, int base, int nelems, int tostore);
+LUAI_FUNC void luaK_fuse(Proto *f);
 
 #endif
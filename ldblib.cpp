@@ -32,6 +32,20 @@ static int db_setmetatable(lua_State *L) {
     return 1;
 }
 
+/*
+** number of hashed keys of a table, the sum of their probe lengths and
+** the longest one
+*/
+static int db_hashstats(lua_State *L) {
+    int nkeys, probes, longest;
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_hashstats(L, 1, &nkeys, &probes, &longest);
+    lua_pushinteger(L, nkeys);
+    lua_pushinteger(L, probes);
+    lua_pushinteger(L, longest);
+    return 3;
+}
+
 static int db_getfenv(lua_State *L) {
     lua_getfenv(L, 1);
     return 1;
@@ -348,6 +362,7 @@ static const luaL_Reg dblib[] = {{"debug", db_debug},
                                  {"getregistry", db_getregistry},
                                  {"getmetatable", db_getmetatable},
                                  {"getupvalue", db_getupvalue},
+                                 {"hashstats", db_hashstats},
                                  {"setfenv", db_setfenv},
                                  {"sethook", db_sethook},
                                  {"setlocal", db_setlocal},
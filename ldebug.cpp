@@ -279,7 +279,7 @@ static Instruction symbexec(const Proto *pt, int lastpc, int reg) {
         pt->sizecode - 1; /* points to final return (a `neutral' instruction) */
     check(precheck(pt));
     for (pc = 0; pc < lastpc; pc++) {
-        Instruction i = pt->code[pc];
+        Instruction i = luaP_unquicken(pt->code[pc]);
         OpCode op = GET_OPCODE(i);
         int a = GETARG_A(i);
         int b = 0;
@@ -421,7 +421,7 @@ static Instruction symbexec(const Proto *pt, int lastpc, int reg) {
             break;
         }
     }
-    return pt->code[last];
+    return luaP_unquicken(pt->code[last]);
 }
 
 #undef check
@@ -430,6 +430,13 @@ static Instruction symbexec(const Proto *pt, int lastpc, int reg) {
 /* }====================================================== */
 
 int luaG_checkcode(const Proto *pt) {
+    for (int pc = 0; pc < pt->sizecode; pc++) { /* no specialized opcodes */
+        Instruction i = pt->code[pc];
+        if (GET_OPCODE(i) >= NUM_OPCODES)
+            return 0;
+        if (GET_OPCODE(i) == OP_SETLIST && GETARG_C(i) == 0)
+            pc++; /* skip its count word */
+    }
     return (symbexec(pt, pt->sizecode, NO_REG) != 0);
 }
 
@@ -489,7 +496,7 @@ static const char *getfuncname(lua_State *L, CallInfo *ci, const char **name) {
     if ((isLua(ci) && ci->tailcalls > 0) || !isLua(ci - 1))
         return nullptr; /* calling function is not Lua (or is unknown) */
     ci--;               /* calling function */
-    Instruction i = ci_func(ci)->l.p->code[currentpc(L, ci)];
+    Instruction i = luaP_unquicken(ci_func(ci)->l.p->code[currentpc(L, ci)]);
     if (GET_OPCODE(i) == OP_CALL || GET_OPCODE(i) == OP_TAILCALL ||
         GET_OPCODE(i) == OP_TFORLOOP)
         return getobjname(L, ci, GETARG_A(i), name);
@@ -526,7 +533,7 @@ void luaG_concaterror(lua_State *L, StkId p1, StkId p2) {
 
 void luaG_aritherror(lua_State *L, const TValue *p1, const TValue *p2) {
     TValue temp;
-    if (luaV_tonumber(p1, &temp) == nullptr)
+    if (luaV_tonumber(L, p1, &temp) == nullptr)
         p2 = p1; /* first operand is wrong */
     luaG_typeerror(L, p2, "perform arithmetic on");
 }
@@ -9,6 +9,9 @@
 
 #define resethookcount(L) (L->hookcount = L->basehookcount)
 
+/* are line or count hooks (the ones run by the interpreter loop) set? */
+#define hasinstrhook(L) (((L)->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) != 0)
+
 LUAI_FUNC void luaG_typeerror(lua_State *L, const TValue *o,
                               const char *opname);
 LUAI_FUNC void luaG_concaterror(lua_State *L, StkId p1, StkId p2);
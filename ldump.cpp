@@ -4,6 +4,7 @@
 #include "lua.h"
 
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
 #include "lundump.h"
 
@@ -34,6 +35,10 @@ static void DumpInt(int x, DumpState *D) { DumpVar(x, D); }
 
 static void DumpNumber(lua_Number x, DumpState *D) { DumpVar(x, D); }
 
+#if LUA_INTSUBTYPE
+static void DumpInteger(l_int64 x, DumpState *D) { DumpVar(x, D); }
+#endif
+
 static void DumpVector(const void *b, int n, size_t size, DumpState *D) {
     DumpInt(n, D);
     DumpMem(b, n, size, D);
@@ -50,7 +55,15 @@ static void DumpString(const TString *s, DumpState *D) {
     }
 }
 
-#define DumpCode(f, D) DumpVector(f->code, f->sizecode, sizeof(Instruction), D)
+static void DumpCode(const Proto *f, DumpState *D) {
+    DumpInt(f->sizecode, D);
+    for (int i = 0; i < f->sizecode; i++) { /* dump only original opcodes */
+        Instruction x = luaP_unquicken(f->code[i]);
+        DumpVar(x, D);
+        if (GET_OPCODE(x) == OP_SETLIST && GETARG_C(x) == 0)
+            DumpVar(f->code[++i], D); /* count word: not an instruction */
+    }
+}
 
 static void DumpFunction(const Proto *f, const TString *p, DumpState *D);
 
@@ -59,8 +72,8 @@ static void DumpConstants(const Proto *f, DumpState *D) {
     DumpInt(n, D);
     for (i = 0; i < n; i++) {
         const TValue *o = &f->k[i];
-        DumpChar(ttype(o), D);
-        switch (ttype(o)) {
+        DumpChar(rawtt(o), D);
+        switch (rawtt(o)) {
         case LUA_TNIL:
             break;
         case LUA_TBOOLEAN:
@@ -69,6 +82,11 @@ static void DumpConstants(const Proto *f, DumpState *D) {
         case LUA_TNUMBER:
             DumpNumber(nvalue(o), D);
             break;
+#if LUA_INTSUBTYPE
+        case LUA_TNUMINT:
+            DumpInteger(ivalue(o), D);
+            break;
+#endif
         case LUA_TSTRING:
             DumpString(rawtsvalue(o), D);
             break;
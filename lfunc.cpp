@@ -1,3 +1,5 @@
+#include <cstring>
+
 #define lfunc_c
 #define LUA_CORE
 
@@ -5,6 +7,7 @@
 
 #include "lfunc.h"
 #include "lgc.h"
+#include "ljit.h"
 #include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
@@ -100,6 +103,11 @@ Proto *luaF_newproto(lua_State *L) {
     f->sizep = 0;
     f->code = nullptr;
     f->sizecode = 0;
+    f->icache = nullptr;
+    f->sizeicache = 0;
+    f->jit = nullptr;
+    f->aot = nullptr;
+    f->hotcount = LUAI_HOTLOOP;
     f->sizelineinfo = 0;
     f->sizeupvalues = 0;
     f->nups = 0;
@@ -117,7 +125,10 @@ Proto *luaF_newproto(lua_State *L) {
 }
 
 void luaF_freeproto(lua_State *L, Proto *f) {
+    if (f->jit)
+        luaJ_free(f);
     luaM_freearray<Instruction>(L, f->code, f->sizecode);
+    luaM_freearray<int>(L, f->icache, f->sizeicache);
     luaM_freearray<Proto *>(L, f->p, f->sizep);
     luaM_freearray<TValue>(L, f->k, f->sizek);
     luaM_freearray<int>(L, f->lineinfo, f->sizelineinfo);
@@ -126,6 +137,16 @@ void luaF_freeproto(lua_State *L, Proto *f) {
     luaM_free(L, f);
 }
 
+/*
+** create the inline caches of a finished function (all slots start at
+** node 0; they are validated on each use)
+*/
+void luaF_initcache(lua_State *L, Proto *f) {
+    f->icache = luaM_newvector<int>(L, f->sizecode);
+    f->sizeicache = f->sizecode;
+    memset(f->icache, 0, f->sizecode * sizeof(int));
+}
+
 void luaF_freeclosure(lua_State *L, Closure *c) {
     int size = (c->c.isC) ? sizeCclosure(c->c.nupvalues)
                           : sizeLclosure(c->l.nupvalues);
@@ -43,6 +43,12 @@
             reallymarkobject(g, gcvalue(o));                                   \
     }
 
+#define markkey(g, n)                                                          \
+    {                                                                          \
+        if (keyiscollectable(n) && iswhite(gckey(n)))                          \
+            reallymarkobject(g, gckey(n));                                     \
+    }
+
 #define markobject(g, t)                                                       \
     {                                                                          \
         if (iswhite(obj2gco(t)))                                               \
@@ -52,8 +58,8 @@
 #define setthreshold(g) (g->GCthreshold = (g->estimate / 100) * g->gcpause)
 
 static void removeentry(Node *n) {
-    if (iscollectable(gkey(n)))
-        setttype(gkey(n), LUA_TDEADKEY); /* dead key; remove it */
+    if (keyiscollectable(n))
+        setdeadkey(n); /* dead key; remove it */
 }
 
 static void reallymarkobject(global_State *g, GCObject *o) {
@@ -141,6 +147,22 @@ size_t luaC_separateudata(lua_State *L, int all) {
     return deadmem;
 }
 
+static void traversenodes(global_State *g, Table *h, int weakkey,
+                          int weakvalue) {
+    int i = sizenode(h);
+    while (i--) {
+        Node *n = gnode(h, i);
+        if (gval(n)->isnil())
+            removeentry(n); /* remove empty entries */
+        else {
+            if (!weakkey)
+                markkey(g, n);
+            if (!weakvalue)
+                markvalue(g, gval(n));
+        }
+    }
+}
+
 static int traversetable(global_State *g, Table *h) {
     int i;
     int weakkey = 0;
@@ -149,8 +171,9 @@ static int traversetable(global_State *g, Table *h) {
         markobject(g, h->metatable);
     const TValue *mode = gfasttm(g, h->metatable, TM_MODE);
     if (mode && mode->isstring()) { /* is there a weak mode? */
-        weakkey = (strchr(svalue(mode), 'k') != nullptr);
-        weakvalue = (strchr(svalue(mode), 'v') != nullptr);
+        size_t l = tsvalue(mode)->len;
+        weakkey = (memchr(svalue(mode), 'k', l) != nullptr);
+        weakvalue = (memchr(svalue(mode), 'v', l) != nullptr);
         if (weakkey || weakvalue) {              /* is really weak? */
             h->marked &= ~(KEYWEAK | VALUEWEAK); /* clear bits */
             h->marked |= cast_byte((weakkey << KEYWEAKBIT) |
@@ -161,23 +184,14 @@ static int traversetable(global_State *g, Table *h) {
     }
     if (weakkey && weakvalue)
         return 1;
-    if (!weakvalue) {
+    if (!weakvalue && !ispacked(h)) { /* raw numbers need no marks */
         i = h->sizearray;
         while (i--)
             markvalue(g, &h->array[i]);
     }
-    i = sizenode(h);
-    while (i--) {
-        Node *n = gnode(h, i);
-        if (gval(n)->isnil())
-            removeentry(n); /* remove empty entries */
-        else {
-            if (!weakkey)
-                markvalue(g, gkey(n));
-            if (!weakvalue)
-                markvalue(g, gval(n));
-        }
-    }
+    traversenodes(g, h, weakkey, weakvalue);
+    if (h->old) /* hash part being moved? */
+        traversenodes(g, h->old, weakkey, weakvalue);
     return weakkey || weakvalue;
 }
 
@@ -257,8 +271,9 @@ static l_mem propagatemark(global_State *g) {
         g->gray = h->gclist;
         if (traversetable(g, h)) /* table is weak? */
             black2gray(o);       /* keep it gray */
-        return sizeof(Table) + sizeof(TValue) * h->sizearray +
-               sizeof(Node) * sizenode(h);
+        return sizeof(Table) + arraybytes(h) +
+               hashbytes(h->lsizenode) +
+               (h->old ? hashbytes(h->old->lsizenode) : 0);
     }
     case LUA_TFUNCTION: {
         Closure *cl = gco2cl(o);
@@ -282,6 +297,7 @@ static l_mem propagatemark(global_State *g) {
         g->gray = p->gclist;
         traverseproto(g, p);
         return sizeof(Proto) + sizeof(Instruction) * p->sizecode +
+               sizeof(int) * p->sizeicache +
                sizeof(Proto *) * p->sizep + sizeof(TValue) * p->sizek +
                sizeof(int) * p->sizelineinfo + sizeof(LocVar) * p->sizelocvars +
                sizeof(TString *) * p->sizeupvalues;
@@ -314,6 +330,20 @@ static int iscleared(const TValue *o, int iskey) {
            (o->isuserdata() && (!iskey && isfinalized(uvalue(o))));
 }
 
+static void clearnodes(Table *h) {
+    int i = sizenode(h);
+    while (i--) {
+        Node *n = gnode(h, i);
+        TValue k;
+        getnodekey(L, &k, n);
+        if (!gval(n)->isnil() && /* non-empty entry? */
+            (iscleared(&k, 1) || iscleared(gval(n), 0))) {
+            setnilvalue(gval(n)); /* remove value ... */
+            removeentry(n);       /* remove entry from table */
+        }
+    }
+}
+
 /*
 ** clear collected entries from weaktables
 */
@@ -321,22 +351,16 @@ static void cleartable(GCObject *l) {
     while (l) {
         Table *h = gco2h(l);
         int i = h->sizearray;
-        if (testbit(h->marked, VALUEWEAKBIT)) {
+        if (testbit(h->marked, VALUEWEAKBIT) && !ispacked(h)) {
             while (i--) {
                 TValue *o = &h->array[i];
                 if (iscleared(o, 0)) /* value was collected? */
                     setnilvalue(o);  /* remove value */
             }
         }
-        i = sizenode(h);
-        while (i--) {
-            Node *n = gnode(h, i);
-            if (!gval(n)->isnil() && /* non-empty entry? */
-                (iscleared(key2tval(n), 1) || iscleared(gval(n), 0))) {
-                setnilvalue(gval(n)); /* remove value ... */
-                removeentry(n);       /* remove entry from table */
-            }
-        }
+        clearnodes(h);
+        if (h->old)
+            clearnodes(h->old);
         l = h->gclist;
     }
 }
@@ -360,8 +384,7 @@ static void freeobj(lua_State *L, GCObject *o) {
         break;
     }
     case LUA_TSTRING: {
-        G(L)->strt.nuse--;
-        luaM_freemem(L, o, sizestring(gco2ts(o)));
+        luaS_free(L, gco2ts(o));
         break;
     }
     case LUA_TUSERDATA: {
@@ -448,8 +471,7 @@ void luaC_freeall(lua_State *L) {
     g->currentwhite =
         WHITEBITS | bitmask(SFIXEDBIT); /* mask to collect all elements */
     sweepwholelist(L, &g->rootgc);
-    for (int i = 0; i < g->strt.size; i++) /* free all string lists */
-        sweepwholelist(L, &g->strt.hash[i]);
+    sweepwholelist(L, &g->strt.list);
 }
 
 static void markmt(global_State *g) {
@@ -501,9 +523,10 @@ static void atomic(lua_State *L) {
     marktmu(g);                        /* mark `preserved' userdata */
     propagateall(g);                   /* remark, to propagate `preserveness' */
     cleartable(g->weak); /* remove collected objects from weak tables */
+    luaT_invalidate(g);  /* cached `__index' entries may refer to dead objects */
     /* flip current white */
     g->currentwhite = cast_byte(otherwhite(g));
-    g->sweepstrgc = 0;
+    g->sweepstrgc = &g->strt.list;
     g->sweepgc = &g->rootgc;
     g->gcstate = GCSsweepstring;
     g->estimate = g->totalbytes - udsize; /* first estimate */
@@ -526,11 +549,11 @@ static l_mem singlestep(lua_State *L) {
     }
     case GCSsweepstring: {
         lu_mem old = g->totalbytes;
-        sweepwholelist(L, &g->strt.hash[g->sweepstrgc++]);
-        if (g->sweepstrgc >= g->strt.size) /* nothing more to sweep? */
-            g->gcstate = GCSsweep;         /* end sweep-string phase */
+        g->sweepstrgc = sweeplist(L, g->sweepstrgc, GCSWEEPMAX);
+        if (*g->sweepstrgc == nullptr) /* nothing more to sweep? */
+            g->gcstate = GCSsweep;     /* end sweep-string phase */
         g->estimate -= old - g->totalbytes;
-        return GCSWEEPCOST;
+        return GCSWEEPMAX * GCSWEEPCOST;
     }
     case GCSsweep: {
         lu_mem old = g->totalbytes;
@@ -585,7 +608,7 @@ void luaC_fullgc(lua_State *L) {
     global_State *g = G(L);
     if (g->gcstate <= GCSpropagate) {
         /* reset sweep marks to sweep all elements (returning them to white) */
-        g->sweepstrgc = 0;
+        g->sweepstrgc = &g->strt.list;
         g->sweepgc = &g->rootgc;
         /* reset other collector lists */
         g->gray = nullptr;
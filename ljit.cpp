@@ -0,0 +1,706 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#define ljit_c
+#define LUA_CORE
+
+#include "lua.h"
+
+#include "ljit.h"
+
+#if LUA_USE_JIT
+
+#include <sys/mman.h>
+
+#include "ldebug.h"
+#include "lgc.h"
+#include "lopcodes.h"
+#include "lstate.h"
+#include "ltable.h"
+#include "ltm.h"
+#include "lvm.h"
+
+/*
+** Baseline compiler: each instruction becomes a fixed template of machine
+** code, with the registers of the function kept in memory (the Lua stack).
+** A template checks the types it relies on and, when a check fails, leaves
+** the machine code at that instruction so that the interpreter executes it
+** (`side exit'). The interpreter enters the code at loop back edges.
+**
+** Machine registers: rbx = base, r12 = constants, r13 = lua_State,
+** r14 = running closure. The code never raises errors, never allocates and
+** never calls Lua code, so the stack cannot move under it.
+*/
+
+enum {
+    RAX,
+    RCX,
+    RDX,
+    RBX,
+    RSP,
+    RBP,
+    RSI,
+    RDI,
+    R8,
+    R9,
+    R10,
+    R11,
+    R12,
+    R13,
+    R14,
+    R15
+};
+
+#define JBASE RBX
+#define JKST R12
+#define JSTATE R13
+#define JCL R14
+
+/* condition codes */
+#define CC_B 0x2
+#define CC_AE 0x3
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_BE 0x6
+#define CC_A 0x7
+#define CC_ALWAYS (-1)
+
+#define TVSIZE cast_int(sizeof(TValue))
+#define TTOFS cast_int(offsetof(TValue, tt))
+
+static_assert(sizeof(TValue) == 16, "unexpected TValue layout");
+
+/* kinds of pending rel32 jumps */
+#define FIX_PC 0   /* to the code of an instruction */
+#define FIX_EXIT 1 /* to the side exit of an instruction */
+
+struct JitFixup {
+    size_t at;  /* position of the rel32 */
+    int kind;
+    int target; /* instruction */
+};
+
+/* machine code, fixups and instruction offsets are kept outside the Lua
+** allocator, so that compiling never raises an error */
+struct JitState {
+    const Proto *p;
+    lu_byte *code;
+    size_t n;
+    size_t size;
+    JitFixup *fix;
+    int nfix;
+    int sizefix;
+    int *pcofs;   /* offset of each instruction */
+    int *exitofs; /* offset of the side exit of each instruction */
+    lu_byte *compiled;
+    size_t epilogue;
+    int failed;
+};
+
+/*
+** {======================================================
+** Emitter
+** =======================================================
+*/
+
+static void reserve(JitState *J, size_t n) {
+    if (!J->failed && J->n + n > J->size) {
+        size_t size = J->size * 2 + n;
+        lu_byte *code = cast(lu_byte *, realloc(J->code, size));
+        if (code == nullptr) {
+            J->failed = 1;
+            return;
+        }
+        J->code = code;
+        J->size = size;
+    }
+}
+
+static void emit1(JitState *J, int b) {
+    reserve(J, 1);
+    if (!J->failed)
+        J->code[J->n++] = cast(lu_byte, b);
+}
+
+static void emit4(JitState *J, lu_int32 u) {
+    for (int i = 0; i < 4; i++, u >>= 8)
+        emit1(J, cast_int(u & 0xFF));
+}
+
+static void emit8(JitState *J, lu_int64 u) {
+    for (int i = 0; i < 8; i++, u >>= 8)
+        emit1(J, cast_int(u & 0xFF));
+}
+
+static void emitrex(JitState *J, int w, int reg, int rm) {
+    int rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+    if (rex != 0x40)
+        emit1(J, rex);
+}
+
+/* prefix, REX and (one or two byte) opcode */
+static void emitop(JitState *J, int pfx, int w, int op, int reg, int rm) {
+    if (pfx)
+        emit1(J, pfx);
+    emitrex(J, w, reg, rm);
+    if (op > 0xFF)
+        emit1(J, op >> 8);
+    emit1(J, op & 0xFF);
+}
+
+/* instruction with operands `reg' and memory at `[base + disp]' */
+static void emitrm(JitState *J, int pfx, int w, int op, int reg, int base,
+                   int disp) {
+    emitop(J, pfx, w, op, reg, base);
+    int small = (-128 <= disp && disp <= 127);
+    emit1(J, (small ? 0x40 : 0x80) | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP) /* rsp and r12 need a SIB byte */
+        emit1(J, 0x24);
+    if (small)
+        emit1(J, disp & 0xFF);
+    else
+        emit4(J, cast(lu_int32, disp));
+}
+
+/* instruction with register operands */
+static void emitrr(JitState *J, int pfx, int w, int op, int reg, int rm) {
+    emitop(J, pfx, w, op, reg, rm);
+    emit1(J, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+static void emitmovimm(JitState *J, int r, lu_int32 imm) {
+    emitrex(J, 0, 0, r);
+    emit1(J, 0xB8 + (r & 7));
+    emit4(J, imm);
+}
+
+static void emitcall(JitState *J, void (*f)()) {
+    emitrex(J, 1, 0, RAX); /* movabs rax, f */
+    emit1(J, 0xB8);
+    emit8(J, cast(lu_int64, reinterpret_cast<uintptr_t>(f)));
+    emitrr(J, 0, 0, 0xFF, 2, RAX); /* call rax */
+}
+
+#define callhelper(J, f) emitcall(J, reinterpret_cast<void (*)()>(f))
+
+/* short forward jump; returns where to patch it with `jhere' */
+static size_t jshort(JitState *J, int cc) {
+    emit1(J, cc == CC_ALWAYS ? 0xEB : 0x70 + cc);
+    emit1(J, 0);
+    return J->n;
+}
+
+static void jhere(JitState *J, size_t at) {
+    if (!J->failed)
+        J->code[at - 1] = cast(lu_byte, J->n - at);
+}
+
+/* jump to instruction `target' (or to its side exit) */
+static void jfix(JitState *J, int cc, int kind, int target) {
+    if (cc == CC_ALWAYS)
+        emit1(J, 0xE9);
+    else {
+        emit1(J, 0x0F);
+        emit1(J, 0x80 + cc);
+    }
+    if (J->nfix >= J->sizefix) {
+        int size = J->sizefix * 2 + 16;
+        JitFixup *fix =
+            cast(JitFixup *, realloc(J->fix, size * sizeof(JitFixup)));
+        if (fix == nullptr) {
+            J->failed = 1;
+            return;
+        }
+        J->fix = fix;
+        J->sizefix = size;
+    }
+    J->fix[J->nfix].at = J->n;
+    J->fix[J->nfix].kind = kind;
+    J->fix[J->nfix].target = target;
+    J->nfix++;
+    emit4(J, 0);
+}
+
+static void patch4(JitState *J, size_t at, size_t dest) {
+    lu_int32 rel = cast(lu_int32, cast(long, dest) - cast(long, at + 4));
+    for (int i = 0; i < 4; i++, rel >>= 8)
+        J->code[at + i] = cast(lu_byte, rel & 0xFF);
+}
+
+/* }====================================================== */
+
+/*
+** {======================================================
+** Helpers called from machine code (they never throw)
+** =======================================================
+*/
+
+static int jitgettable(lua_State *L, const TValue *t, const TValue *key,
+                       StkId ra) {
+    return t->istable() && luaV_fastget(L, hvalue(t), key, ra);
+}
+
+static int jitsettable(lua_State *L, const TValue *t, const TValue *key,
+                       const TValue *val) {
+    return t->istable() && luaV_fastset(L, hvalue(t), key, val);
+}
+
+static int jitgetglobal(lua_State *L, LClosure *cl, const TValue *key,
+                        StkId ra) {
+    return luaV_fastget(L, cl->env, key, ra);
+}
+
+static int jitsetglobal(lua_State *L, LClosure *cl, const TValue *key,
+                        const TValue *val) {
+    return luaV_fastset(L, cl->env, key, val);
+}
+
+static void jitsetupval(lua_State *L, LClosure *cl, int b, const TValue *ra) {
+    UpVal *uv = cl->upvals[b];
+    setobj(L, uv->v, ra);
+    luaC_barrier(L, uv, ra);
+}
+
+static lua_Number jitmod(lua_Number a, lua_Number b) {
+    return luai_nummod(a, b);
+}
+
+static lua_Number jitpow(lua_Number a, lua_Number b) {
+    return luai_numpow(a, b);
+}
+
+/* }====================================================== */
+
+/*
+** {======================================================
+** Templates
+** =======================================================
+*/
+
+#define RDISP(r) ((r)*TVSIZE)
+
+static int rkbase(int x) { return ISK(x) ? JKST : JBASE; }
+
+static int rkdisp(int x) { return RDISP(ISK(x) ? INDEXK(x) : x); }
+
+/* can RK(x) be used as a number? (registers are checked when running) */
+static int numoperand(const Proto *p, int x) {
+    return !ISK(x) || p->k[INDEXK(x)].isnumber();
+}
+
+static void guardnum(JitState *J, int x, int pc) {
+    if (!ISK(x)) {
+        emitrm(J, 0, 0, 0x80, 7, JBASE, RDISP(x) + TTOFS); /* cmp tt, imm8 */
+        emit1(J, LUA_TNUMBER);
+        jfix(J, CC_NE, FIX_EXIT, pc);
+    }
+}
+
+/* [db + dd] := [sb + sd] */
+static void copytv(JitState *J, int db, int dd, int sb, int sd) {
+    emitrm(J, 0, 1, 0x8B, RAX, sb, sd); /* value */
+    emitrm(J, 0, 1, 0x89, RAX, db, dd);
+    emitrm(J, 0, 0, 0x0FB6, RCX, sb, sd + TTOFS); /* tag */
+    emitrm(J, 0, 0, 0x88, RCX, db, dd + TTOFS);
+}
+
+static void settag(JitState *J, int r, int tt) {
+    emitrm(J, 0, 0, 0xC6, 0, JBASE, RDISP(r) + TTOFS);
+    emit1(J, tt);
+}
+
+/* eax := l_isfalse(R(r)) */
+static void isfalse(JitState *J, int r) {
+    emitrm(J, 0, 0, 0x0FB6, RCX, JBASE, RDISP(r) + TTOFS);
+    emitrr(J, 0, 0, 0x31, RAX, RAX);    /* xor eax, eax */
+    emitrr(J, 0, 0, 0x85, RCX, RCX);    /* nil? */
+    size_t l1 = jshort(J, CC_E);
+    emitrr(J, 0, 0, 0x83, 7, RCX);      /* cmp ecx, LUA_TBOOLEAN */
+    emit1(J, LUA_TBOOLEAN);
+    size_t l2 = jshort(J, CC_NE);
+    emitrm(J, 0, 0, 0x83, 7, JBASE, RDISP(r)); /* cmp b, 0 */
+    emit1(J, 0);
+    size_t l3 = jshort(J, CC_NE);
+    jhere(J, l1);
+    emitmovimm(J, RAX, 1);
+    jhere(J, l2);
+    jhere(J, l3);
+}
+
+/* go to `target' from `pc', leaving at back edges when a hook is set */
+static void branch(JitState *J, int pc, int target) {
+    if (target <= pc) {
+        emitrm(J, 0, 0, 0xF6, 0, JSTATE, offsetof(lua_State, hookmask));
+        emit1(J, LUA_MASKLINE | LUA_MASKCOUNT); /* test byte, imm8 */
+        jfix(J, CC_NE, FIX_EXIT, target);
+    }
+    jfix(J, CC_ALWAYS, FIX_PC, target);
+}
+
+/* conditional jump in the style of OP_EQ: `cc' holds if the jump is taken */
+static void condjump(JitState *J, int pc, int cc) {
+    int target = pc + 2 + GETARG_sBx(J->p->code[pc + 1]);
+    size_t no = jshort(J, cc ^ 1); /* negated condition */
+    branch(J, pc, target);
+    jhere(J, no);
+    jfix(J, CC_ALWAYS, FIX_PC, pc + 2);
+}
+
+static int arith(JitState *J, Instruction i, int pc, int sseop) {
+    int a = GETARG_A(i), b = GETARG_B(i), c = GETARG_C(i);
+    if (!numoperand(J->p, b) || !numoperand(J->p, c))
+        return 0;
+    guardnum(J, b, pc);
+    guardnum(J, c, pc);
+    emitrm(J, 0xF2, 0, 0x0F10, 0, rkbase(b), rkdisp(b)); /* movsd xmm0 */
+    emitrm(J, 0xF2, 0, sseop, 0, rkbase(c), rkdisp(c));
+    emitrm(J, 0xF2, 0, 0x0F11, 0, JBASE, RDISP(a));
+    settag(J, a, LUA_TNUMBER);
+    return 1;
+}
+
+static int arithcall(JitState *J, Instruction i, int pc,
+                     lua_Number (*f)(lua_Number, lua_Number)) {
+    int a = GETARG_A(i), b = GETARG_B(i), c = GETARG_C(i);
+    if (!numoperand(J->p, b) || !numoperand(J->p, c))
+        return 0;
+    guardnum(J, b, pc);
+    guardnum(J, c, pc);
+    emitrm(J, 0xF2, 0, 0x0F10, 0, rkbase(b), rkdisp(b));
+    emitrm(J, 0xF2, 0, 0x0F10, 1, rkbase(c), rkdisp(c));
+    callhelper(J, f);
+    emitrm(J, 0xF2, 0, 0x0F11, 0, JBASE, RDISP(a));
+    settag(J, a, LUA_TNUMBER);
+    return 1;
+}
+
+static int compare(JitState *J, Instruction i, int pc, int cc) {
+    int b = GETARG_B(i), c = GETARG_C(i);
+    if (!numoperand(J->p, b) || !numoperand(J->p, c))
+        return 0;
+    guardnum(J, b, pc);
+    guardnum(J, c, pc);
+    /* ucomisd RK(C), RK(B): `above' is B < C, `above or equal' B <= C */
+    emitrm(J, 0xF2, 0, 0x0F10, 0, rkbase(c), rkdisp(c));
+    emitrm(J, 0x66, 0, 0x0F2E, 0, rkbase(b), rkdisp(b));
+    condjump(J, pc, GETARG_A(i) ? cc : cc ^ 1);
+    return 1;
+}
+
+/* call f(L, <rsi>, <rdx>, <rcx>) and leave if it returns 0 */
+static void checkcall(JitState *J, void (*f)(), int pc) {
+    emitrr(J, 0, 1, 0x89, JSTATE, RDI); /* mov rdi, r13 */
+    emitcall(J, f);
+    emitrr(J, 0, 0, 0x85, RAX, RAX);
+    jfix(J, CC_E, FIX_EXIT, pc);
+}
+
+#define checkhelper(J, f, pc) checkcall(J, reinterpret_cast<void (*)()>(f), pc)
+
+/* emit instruction `pc'; returns 0 (emitting nothing) if not supported */
+static int compileop(JitState *J, int pc) {
+    const Proto *p = J->p;
+    Instruction i = p->code[pc];
+    int a = GETARG_A(i);
+    switch (luaP_baseop[GET_OPCODE(i)]) {
+    case OP_MOVE:
+        copytv(J, JBASE, RDISP(a), JBASE, RDISP(GETARG_B(i)));
+        return 1;
+    case OP_LOADK:
+        copytv(J, JBASE, RDISP(a), JKST, RDISP(GETARG_Bx(i)));
+        return 1;
+    case OP_LOADBOOL:
+        emitrm(J, 0, 0, 0xC7, 0, JBASE, RDISP(a));
+        emit4(J, cast(lu_int32, GETARG_B(i)));
+        settag(J, a, LUA_TBOOLEAN);
+        if (GETARG_C(i))
+            jfix(J, CC_ALWAYS, FIX_PC, pc + 2);
+        return 1;
+    case OP_LOADNIL:
+        for (int r = a; r <= GETARG_B(i); r++)
+            settag(J, r, LUA_TNIL);
+        return 1;
+    case OP_GETUPVAL:
+        emitrm(J, 0, 1, 0x8B, RDX, JCL,
+               offsetof(LClosure, upvals) + GETARG_B(i) * sizeof(UpVal *));
+        emitrm(J, 0, 1, 0x8B, RDX, RDX, offsetof(UpVal, v));
+        copytv(J, JBASE, RDISP(a), RDX, 0);
+        return 1;
+    case OP_SETUPVAL:
+        emitrr(J, 0, 1, 0x89, JSTATE, RDI);
+        emitrr(J, 0, 1, 0x89, JCL, RSI);
+        emitmovimm(J, RDX, cast(lu_int32, GETARG_B(i)));
+        emitrm(J, 0, 1, 0x8D, RCX, JBASE, RDISP(a)); /* lea */
+        callhelper(J, jitsetupval);
+        return 1;
+    case OP_GETGLOBAL:
+        emitrr(J, 0, 1, 0x89, JCL, RSI);
+        emitrm(J, 0, 1, 0x8D, RDX, JKST, RDISP(GETARG_Bx(i)));
+        emitrm(J, 0, 1, 0x8D, RCX, JBASE, RDISP(a));
+        checkhelper(J, jitgetglobal, pc);
+        return 1;
+    case OP_SETGLOBAL:
+        emitrr(J, 0, 1, 0x89, JCL, RSI);
+        emitrm(J, 0, 1, 0x8D, RDX, JKST, RDISP(GETARG_Bx(i)));
+        emitrm(J, 0, 1, 0x8D, RCX, JBASE, RDISP(a));
+        checkhelper(J, jitsetglobal, pc);
+        return 1;
+    case OP_GETTABLE: {
+        int c = GETARG_C(i);
+        emitrm(J, 0, 1, 0x8D, RSI, JBASE, RDISP(GETARG_B(i)));
+        emitrm(J, 0, 1, 0x8D, RDX, rkbase(c), rkdisp(c));
+        emitrm(J, 0, 1, 0x8D, RCX, JBASE, RDISP(a));
+        checkhelper(J, jitgettable, pc);
+        return 1;
+    }
+    case OP_SETTABLE: {
+        int b = GETARG_B(i), c = GETARG_C(i);
+        emitrm(J, 0, 1, 0x8D, RSI, JBASE, RDISP(a));
+        emitrm(J, 0, 1, 0x8D, RDX, rkbase(b), rkdisp(b));
+        emitrm(J, 0, 1, 0x8D, RCX, rkbase(c), rkdisp(c));
+        checkhelper(J, jitsettable, pc);
+        return 1;
+    }
+    case OP_ADD:
+        return arith(J, i, pc, 0x0F58);
+    case OP_SUB:
+        return arith(J, i, pc, 0x0F5C);
+    case OP_MUL:
+        return arith(J, i, pc, 0x0F59);
+    case OP_DIV:
+        return arith(J, i, pc, 0x0F5E);
+    case OP_MOD:
+        return arithcall(J, i, pc, jitmod);
+    case OP_POW:
+        return arithcall(J, i, pc, jitpow);
+    case OP_UNM: {
+        int b = GETARG_B(i);
+        guardnum(J, b, pc);
+        emitrm(J, 0, 1, 0x8B, RAX, JBASE, RDISP(b));
+        emitrr(J, 0, 1, 0x0FBA, 7, RAX); /* btc rax, 63 */
+        emit1(J, 63);
+        emitrm(J, 0, 1, 0x89, RAX, JBASE, RDISP(a));
+        settag(J, a, LUA_TNUMBER);
+        return 1;
+    }
+    case OP_NOT:
+        isfalse(J, GETARG_B(i));
+        emitrm(J, 0, 0, 0x89, RAX, JBASE, RDISP(a));
+        settag(J, a, LUA_TBOOLEAN);
+        return 1;
+    case OP_LEN:
+        emitrm(J, 0, 1, 0x8D, RDI, JBASE, RDISP(GETARG_B(i)));
+        emitrm(J, 0, 1, 0x8D, RSI, JBASE, RDISP(a));
+        callhelper(J, luaV_fastlen);
+        emitrr(J, 0, 0, 0x85, RAX, RAX);
+        jfix(J, CC_E, FIX_EXIT, pc);
+        return 1;
+    case OP_JMP:
+        branch(J, pc, pc + 1 + GETARG_sBx(i));
+        return 1;
+    case OP_EQ: {
+        int b = GETARG_B(i), c = GETARG_C(i);
+        emitrm(J, 0, 1, 0x8D, RDI, rkbase(b), rkdisp(b));
+        emitrm(J, 0, 1, 0x8D, RSI, rkbase(c), rkdisp(c));
+        callhelper(J, luaV_fasteq);
+        emitrr(J, 0, 0, 0x83, 7, RAX); /* cmp eax, -1 */
+        emit1(J, 0xFF);
+        jfix(J, CC_E, FIX_EXIT, pc);
+        emitrr(J, 0, 0, 0x83, 7, RAX); /* cmp eax, A */
+        emit1(J, a);
+        condjump(J, pc, CC_E);
+        return 1;
+    }
+    case OP_LT:
+        return compare(J, i, pc, CC_A);
+    case OP_LE:
+        return compare(J, i, pc, CC_AE);
+    case OP_TEST:
+        isfalse(J, a);
+        emitrr(J, 0, 0, 0x83, 7, RAX);
+        emit1(J, GETARG_C(i));
+        condjump(J, pc, CC_NE);
+        return 1;
+    case OP_TESTSET: {
+        int b = GETARG_B(i);
+        int target = pc + 2 + GETARG_sBx(p->code[pc + 1]);
+        isfalse(J, b);
+        emitrr(J, 0, 0, 0x83, 7, RAX);
+        emit1(J, GETARG_C(i));
+        size_t no = jshort(J, CC_E);
+        copytv(J, JBASE, RDISP(a), JBASE, RDISP(b));
+        branch(J, pc, target);
+        jhere(J, no);
+        jfix(J, CC_ALWAYS, FIX_PC, pc + 2);
+        return 1;
+    }
+    case OP_FORLOOP: {
+        emitrm(J, 0xF2, 0, 0x0F10, 2, JBASE, RDISP(a + 2)); /* xmm2 = step */
+        emitrm(J, 0xF2, 0, 0x0F10, 0, JBASE, RDISP(a));     /* xmm0 = idx */
+        emitrr(J, 0xF2, 0, 0x0F58, 0, 2);                   /* idx += step */
+        emitrm(J, 0xF2, 0, 0x0F10, 1, JBASE, RDISP(a + 1)); /* xmm1 = limit */
+        emitrr(J, 0x66, 0, 0x0F57, 3, 3);                   /* xmm3 = 0 */
+        emitrr(J, 0x66, 0, 0x0F2E, 2, 3);                   /* 0 < step? */
+        size_t neg = jshort(J, CC_BE);
+        emitrr(J, 0x66, 0, 0x0F2E, 1, 0); /* idx <= limit? */
+        size_t done1 = jshort(J, CC_B);
+        size_t loop = jshort(J, CC_ALWAYS);
+        jhere(J, neg);
+        emitrr(J, 0x66, 0, 0x0F2E, 0, 1); /* limit <= idx? */
+        size_t done2 = jshort(J, CC_B);
+        jhere(J, loop);
+        emitrm(J, 0xF2, 0, 0x0F11, 0, JBASE, RDISP(a));
+        emitrm(J, 0xF2, 0, 0x0F11, 0, JBASE, RDISP(a + 3));
+        settag(J, a + 3, LUA_TNUMBER);
+        branch(J, pc, pc + 1 + GETARG_sBx(i));
+        jhere(J, done1);
+        jhere(J, done2);
+        return 1;
+    }
+    case OP_FORPREP:
+        guardnum(J, a, pc);
+        guardnum(J, a + 1, pc);
+        guardnum(J, a + 2, pc);
+        emitrm(J, 0xF2, 0, 0x0F10, 0, JBASE, RDISP(a));
+        emitrm(J, 0xF2, 0, 0x0F5C, 0, JBASE, RDISP(a + 2));
+        emitrm(J, 0xF2, 0, 0x0F11, 0, JBASE, RDISP(a));
+        jfix(J, CC_ALWAYS, FIX_PC, pc + 1 + GETARG_sBx(i));
+        return 1;
+    default: /* calls, closures, concatenation, ...: interpreter */
+        return 0;
+    }
+}
+
+/* }====================================================== */
+
+static void exitstub(JitState *J, int pc) {
+    emitmovimm(J, RAX, cast(lu_int32, pc));
+    emit1(J, 0xE9);
+    emit4(J, 0);
+    if (!J->failed)
+        patch4(J, J->n - 4, J->epilogue);
+}
+
+static void prologue(JitState *J) {
+    /* five registers keep the stack aligned for calls */
+    static const int saved[] = {RBX, R12, R13, R14, R15};
+    for (int r : saved) {
+        emitrex(J, 0, 0, r);
+        emit1(J, 0x50 + (r & 7)); /* push */
+    }
+    emitrr(J, 0, 1, 0x89, RDI, JSTATE); /* mov r13, rdi */
+    emitrr(J, 0, 1, 0x89, RSI, JBASE);
+    emitrr(J, 0, 1, 0x89, RDX, JKST);
+    emitrr(J, 0, 1, 0x89, RCX, JCL);
+    emitrr(J, 0, 0, 0xFF, 4, R8); /* jmp r8 */
+    J->epilogue = J->n;
+    for (int k = 4; k >= 0; k--) {
+        emitrex(J, 0, 0, saved[k]);
+        emit1(J, 0x58 + (saved[k] & 7)); /* pop */
+    }
+    emit1(J, 0xC3); /* ret */
+}
+
+static void freestate(JitState *J) {
+    free(J->code);
+    free(J->fix);
+    free(J->pcofs);
+    free(J->exitofs);
+    free(J->compiled);
+}
+
+void luaJ_compile(lua_State *L, Proto *p) {
+    UNUSED(L);
+    JitState J;
+    int n = p->sizecode;
+    memset(&J, 0, sizeof(J));
+    J.p = p;
+    J.pcofs = cast(int *, malloc(n * sizeof(int)));
+    J.exitofs = cast(int *, malloc(n * sizeof(int)));
+    J.compiled = cast(lu_byte *, calloc(n, 1));
+    if (J.pcofs == nullptr || J.exitofs == nullptr || J.compiled == nullptr) {
+        freestate(&J);
+        return;
+    }
+    prologue(&J);
+    int count = 0; /* is `pc' the count word of a SETLIST? */
+    for (int pc = 0; pc < n; pc++) {
+        Instruction i = p->code[pc];
+        J.pcofs[pc] = cast_int(J.n);
+        J.exitofs[pc] = -1;
+        if (!count && compileop(&J, pc))
+            J.compiled[pc] = 1;
+        else {
+            J.exitofs[pc] = cast_int(J.n);
+            exitstub(&J, pc);
+        }
+        count = !count && GET_OPCODE(i) == OP_SETLIST && GETARG_C(i) == 0;
+    }
+    for (int f = 0; f < J.nfix && !J.failed; f++) {
+        JitFixup *fx = &J.fix[f];
+        size_t dest;
+        if (fx->kind == FIX_PC)
+            dest = J.pcofs[fx->target];
+        else {
+            if (J.exitofs[fx->target] < 0) { /* create the side exit */
+                J.exitofs[fx->target] = cast_int(J.n);
+                exitstub(&J, fx->target);
+            }
+            dest = J.exitofs[fx->target];
+        }
+        if (!J.failed)
+            patch4(&J, fx->at, dest);
+    }
+    JitCode *jc = nullptr;
+    void *mem = MAP_FAILED;
+    if (!J.failed) {
+        jc = cast(JitCode *, malloc(sizeof(JitCode)));
+        mem = mmap(nullptr, J.n, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANON, -1, 0);
+    }
+    if (jc == nullptr || mem == MAP_FAILED) {
+        free(jc);
+        freestate(&J);
+        return; /* `hotcount' is 0: do not try again */
+    }
+    memcpy(mem, J.code, J.n);
+    if (mprotect(mem, J.n, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, J.n);
+        free(jc);
+        freestate(&J);
+        return;
+    }
+    jc->mcode = cast(lu_byte *, mem);
+    jc->size = J.n;
+    jc->entry = J.pcofs;
+    for (int pc = 0; pc < n; pc++)
+        if (!J.compiled[pc])
+            jc->entry[pc] = -1;
+    J.pcofs = nullptr; /* now owned by `jc' */
+    freestate(&J);
+    p->jit = jc;
+}
+
+typedef int (*JitEntry)(lua_State *L, StkId base, TValue *k, LClosure *cl,
+                        const lu_byte *start);
+
+const Instruction *luaJ_run(lua_State *L, LClosure *cl, StkId base,
+                            const Instruction *pc) {
+    Proto *p = cl->p;
+    JitCode *jc = p->jit;
+    JitEntry f = reinterpret_cast<JitEntry>(
+        reinterpret_cast<uintptr_t>(jc->mcode));
+    int npc = f(L, base, p->k, cl, jc->mcode + jc->entry[pc - p->code]);
+    return p->code + npc;
+}
+
+void luaJ_free(Proto *p) {
+    munmap(p->jit->mcode, p->jit->size);
+    free(p->jit->entry);
+    free(p->jit);
+    p->jit = nullptr;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef ljit_h
+#define ljit_h
+
+#include "lobject.h"
+
+/*
+** LUA_USE_JIT compiles the loops of hot functions to x86-64 machine code.
+** The compiled code covers moves, constants, arithmetic, comparisons,
+** jumps, numeric for loops and plain table/global/upvalue access; on
+** anything else (calls, metamethods, errors, allocation) or when a hook is
+** set, it returns to the interpreter at the instruction it stopped at.
+*/
+#ifndef LUA_USE_JIT
+#define LUA_USE_JIT 0
+#endif
+
+#if LUA_USE_JIT
+
+#if !defined(__x86_64__) || !(defined(__linux__) || defined(__APPLE__))
+#error "LUA_USE_JIT needs x86-64 and mmap"
+#endif
+
+#if LUA_NANBOXING || LUA_INTSUBTYPE
+#error "LUA_USE_JIT needs the default value representation"
+#endif
+
+/* loop iterations a function runs before it is compiled */
+#ifndef LUAI_HOTLOOP
+#define LUAI_HOTLOOP 56
+#endif
+
+struct JitCode {
+    lu_byte *mcode; /* machine code (its prologue is the entry point) */
+    size_t size;
+    int *entry; /* offset of each instruction in `mcode' (-1: not compiled) */
+};
+
+/* can `p' continue in machine code at `pc'? */
+#define luaJ_hasentry(p, pc)                                                   \
+    ((p)->jit != nullptr && (p)->jit->entry[(pc) - (p)->code] >= 0)
+
+LUAI_FUNC void luaJ_compile(lua_State *L, Proto *p);
+LUAI_FUNC const Instruction *luaJ_run(lua_State *L, LClosure *cl, StkId base,
+                                      const Instruction *pc);
+LUAI_FUNC void luaJ_free(Proto *p);
+
+#else
+
+#define LUAI_HOTLOOP 0
+#define luaJ_free(p) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,93 @@
+/*
+** Jump table used by `luaV_execute' when the compiler supports labels as
+** values (included inside the function body).
+** Each handler ends by fetching and dispatching the next instruction, so
+** every opcode gets its own indirect branch (and its own prediction slot).
+*/
+
+#undef vmdispatch
+#undef vmcase
+#undef vmbreak
+#undef vmnext
+
+#define vmdispatch(x) goto *disptab[x];
+
+#define vmcase(l) L_##l:
+
+#define vmbreak                                                                \
+    {                                                                          \
+        vmfetch();                                                             \
+        vmdispatch(GET_OPCODE(i));                                             \
+    }
+
+/* superinstructions know the next opcode: a direct jump to its handler */
+#define vmnext(o)                                                              \
+    {                                                                          \
+        vmfetch();                                                             \
+        goto L_##o;                                                            \
+    }
+
+/* labels as values are an extension: no warnings for them in this
+   function (popped after the end of `execute') */
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+/* ORDER OP */
+static const void *const disptab[NUM_VMOPCODES] = {
+    &&L_OP_MOVE,
+    &&L_OP_LOADK,
+    &&L_OP_LOADBOOL,
+    &&L_OP_LOADNIL,
+    &&L_OP_GETUPVAL,
+    &&L_OP_GETGLOBAL,
+    &&L_OP_GETTABLE,
+    &&L_OP_SETGLOBAL,
+    &&L_OP_SETUPVAL,
+    &&L_OP_SETTABLE,
+    &&L_OP_NEWTABLE,
+    &&L_OP_SELF,
+    &&L_OP_ADD,
+    &&L_OP_SUB,
+    &&L_OP_MUL,
+    &&L_OP_DIV,
+    &&L_OP_MOD,
+    &&L_OP_POW,
+    &&L_OP_UNM,
+    &&L_OP_NOT,
+    &&L_OP_LEN,
+    &&L_OP_CONCAT,
+    &&L_OP_JMP,
+    &&L_OP_EQ,
+    &&L_OP_LT,
+    &&L_OP_LE,
+    &&L_OP_TEST,
+    &&L_OP_TESTSET,
+    &&L_OP_CALL,
+    &&L_OP_TAILCALL,
+    &&L_OP_RETURN,
+    &&L_OP_FORLOOP,
+    &&L_OP_FORPREP,
+    &&L_OP_TFORLOOP,
+    &&L_OP_SETLIST,
+    &&L_OP_CLOSE,
+    &&L_OP_CLOSURE,
+    &&L_OP_VARARG,
+    &&L_OP_ADD_NN,
+    &&L_OP_SUB_NN,
+    &&L_OP_MUL_NN,
+    &&L_OP_DIV_NN,
+    &&L_OP_ADD_NK,
+    &&L_OP_SUB_NK,
+    &&L_OP_MUL_NK,
+    &&L_OP_DIV_NK,
+    &&L_OP_LT_NN,
+    &&L_OP_LE_NN,
+    &&L_OP_GETTABLE_GETTABLE,
+    &&L_OP_GETTABLE_CALL,
+    &&L_OP_GETGLOBAL_GETTABLE,
+    &&L_OP_SETTABLE_FORLOOP,
+    &&L_OP_SELF_CALL,
+    &&L_OP_MOVE_CALL,
+};
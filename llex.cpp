@@ -8,6 +8,7 @@
 #include "lua.h"
 
 #include "ldo.h"
+#include "lgc.h"
 #include "llex.h"
 #include "lobject.h"
 #include "lparser.h"
@@ -25,7 +26,7 @@ const char *const luaX_tokens[] = {
     "for",    "function", "if",     "in",   "local",  "nil",   "not",
     "or",     "repeat",   "return", "then", "true",   "until", "while",
     "..",     "...",      "==",     ">=",   "<=",     "~=",    "<number>",
-    "<name>", "<string>", "<eof>",  nullptr};
+    "<integer>", "<name>", "<string>", "<eof>", nullptr};
 
 #define save_and_next(ls) (save(ls, ls->current), next(ls))
 
@@ -41,11 +42,17 @@ static void save(LexState *ls, int c) {
     b->buffer[b->n++] = cast(char, c);
 }
 
+/* reserved words are found through their interned strings */
+static_assert(LUAI_MAXSHORTLEN >= sizeof("function") - 1,
+              "reserved words must be short strings");
+static_assert(NUM_RESERVED <= RESERVEDMASK,
+              "reserved word indices must fit below the string flags");
+
 void luaX_init(lua_State *L) {
     for (int i = 0; i < NUM_RESERVED; i++) {
         TString *ts = luaS_new(L, luaX_tokens[i]);
         luaS_fix(ts); /* reserved words are never collected */
-        ts->reserved = cast_byte(i + 1); /* reserved word */
+        ts->reserved |= cast_byte(i + 1); /* reserved word */
     }
 }
 
@@ -64,6 +71,7 @@ static const char *txtToken(LexState *ls, int token) {
     case TK_NAME:
     case TK_STRING:
     case TK_NUMBER:
+    case TK_INT:
         save(ls, '\0');
         return luaZ_buffer(ls->buff);
     default:
@@ -87,6 +95,14 @@ void luaX_syntaxerror(LexState *ls, const char *msg) {
 TString *luaX_newstring(LexState *ls, const char *str, size_t l) {
     lua_State *L = ls->L;
     TString *ts = luaS_newlstr(L, str, l);
+    if (islongstr(ts)) { /* not interned: names are compared by address */
+        TValue *s = luaH_setstr(L, ls->h, ts);
+        if (s->isnil()) {
+            setsvalue(L, s, ts);
+            luaC_barriert(L, ls->h, s);
+        } else
+            ts = rawtsvalue(s); /* use the chunk's first copy */
+    }
     TValue *o = luaH_setstr(L, ls->fs->h, ts); /* entry for `str' */
     if (o->isnil())
         setbvalue(o, 1); /* make sure `str' will not be collected */
@@ -151,7 +167,7 @@ static void trydecpoint(LexState *ls, SemInfo *seminfo) {
 }
 
 /* LUA_NUMBER */
-static void read_numeral(LexState *ls, SemInfo *seminfo) {
+static int read_numeral(LexState *ls, SemInfo *seminfo) {
     do {
         save_and_next(ls);
     } while (isdigit(ls->current) || ls->current == '.');
@@ -161,8 +177,13 @@ static void read_numeral(LexState *ls, SemInfo *seminfo) {
         save_and_next(ls);
     save(ls, '\0');
     buffreplace(ls, '.', ls->decpoint); /* follow locale for decimal point */
+#if LUA_INTSUBTYPE
+    if (luaO_str2int(luaZ_buffer(ls->buff), &seminfo->i))
+        return TK_INT;
+#endif
     if (!luaO_str2d(luaZ_buffer(ls->buff), &seminfo->r)) /* format error? */
         trydecpoint(ls, seminfo); /* try to update decimal point separator */
+    return TK_NUMBER;
 }
 
 static int skip_sep(LexState *ls) {
@@ -384,8 +405,7 @@ static int llex(LexState *ls, SemInfo *seminfo) {
             } else if (!isdigit(ls->current))
                 return '.';
             else {
-                read_numeral(ls, seminfo);
-                return TK_NUMBER;
+                return read_numeral(ls, seminfo);
             }
         }
         case EOZ: {
@@ -396,8 +416,7 @@ static int llex(LexState *ls, SemInfo *seminfo) {
                 next(ls);
                 continue;
             } else if (isdigit(ls->current)) {
-                read_numeral(ls, seminfo);
-                return TK_NUMBER;
+                return read_numeral(ls, seminfo);
             } else if (isalpha(ls->current) || ls->current == '_') {
                 /* identifier or reserved word */
                 TString *ts;
@@ -406,8 +425,8 @@ static int llex(LexState *ls, SemInfo *seminfo) {
                 } while (isalnum(ls->current) || ls->current == '_');
                 ts = luaX_newstring(ls, luaZ_buffer(ls->buff),
                                     luaZ_bufflen(ls->buff));
-                if (ts->reserved > 0) /* reserved word? */
-                    return ts->reserved - 1 + FIRST_RESERVED;
+                if (isreserved(ts)) /* reserved word? */
+                    return isreserved(ts) - 1 + FIRST_RESERVED;
                 else {
                     seminfo->ts = ts;
                     return TK_NAME;
@@ -44,6 +44,7 @@ enum RESERVED {
     TK_LE,
     TK_NE,
     TK_NUMBER,
+    TK_INT,
     TK_NAME,
     TK_STRING,
     TK_EOS
@@ -57,6 +58,7 @@ LUAI_DATA const char *const luaX_tokens[];
 
 union SemInfo {
     lua_Number r;
+    l_int64 i; /* for TK_INT */
     TString *ts;
 }; /* semantics information */
 
@@ -76,6 +78,7 @@ struct LexState {
     ZIO *z;          /* input stream */
     Mbuffer *buff;   /* buffer for tokens */
     TString *source; /* current source name */
+    Table *h;        /* long strings of the chunk, each mapped to itself */
     char decpoint;   /* locale decimal point */
 };
 
@@ -8,6 +8,13 @@
 
 using lu_int32 = LUAI_UINT32;
 
+using lu_int64 = LUAI_UINT64;
+
+using l_int64 = LUAI_INT64;
+
+#define MAX_LINT64 LLONG_MAX
+#define MIN_LINT64 LLONG_MIN
+
 using lu_mem = LUAI_UMEM;
 
 using l_mem = LUAI_MEM;
@@ -36,6 +43,14 @@ using l_uacNumber = LUA_NUMBER;
 #define cast_num(i) cast(lua_Number, (i))
 #define cast_int(i) cast(int, (i))
 
+/* checks on the arguments of API functions (with LUA_USE_APICHECK) */
+#ifdef LUA_USE_APICHECK
+#include <cassert>
+#define api_check(L, o) assert(o)
+#else
+#define api_check(L, o) ((void)(L))
+#endif
+
 /*
 ** type for virtual-machine instructions
 ** must be an unsigned with (at least) 4 bytes (see details in lopcodes.h)
@@ -15,7 +15,7 @@
 #include "lstring.h"
 #include "lvm.h"
 
-const TValue luaO_nilobject_ = {{nullptr}, LUA_TNIL};
+const TValue luaO_nilobject_ = NILCONSTANT;
 
 /*
 ** converts an integer to a "floating point byte", represented as
@@ -72,11 +72,17 @@ int luaO_rawequalObj(const TValue *t1, const TValue *t2) {
         case LUA_TNIL:
             return 1;
         case LUA_TNUMBER:
+#if LUA_INTSUBTYPE
+            return luaO_numeq(t1, t2);
+#else
             return luai_numeq(nvalue(t1), nvalue(t2));
+#endif
         case LUA_TBOOLEAN:
             return bvalue(t1) == bvalue(t2); /* boolean true must be 1 !! */
         case LUA_TLIGHTUSERDATA:
             return pvalue(t1) == pvalue(t2);
+        case LUA_TSTRING:
+            return luaS_eqstr(rawtsvalue(t1), rawtsvalue(t2));
         default:
             return gcvalue(t1) == gcvalue(t2);
         }
@@ -98,6 +104,38 @@ int luaO_str2d(const char *s, lua_Number *result) {
     return 1;
 }
 
+/*
+** convert a decimal or hexadecimal numeral with no fraction or exponent;
+** fails if the value does not fit in an l_int64
+*/
+int luaO_str2int(const char *s, l_int64 *result) {
+    lu_int64 a = 0;
+    int empty = 1;
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        for (s += 2; isxdigit(cast(unsigned char, *s)); s++, empty = 0) {
+            int d = isdigit(cast(unsigned char, *s))
+                        ? *s - '0'
+                        : tolower(cast(unsigned char, *s)) - 'a' + 10;
+            if (a > cast(lu_int64, MAX_LINT64 - d) / 16)
+                return 0; /* overflow */
+            a = a * 16 + d;
+        }
+    } else {
+        for (; isdigit(cast(unsigned char, *s)); s++, empty = 0) {
+            int d = *s - '0';
+            if (a > cast(lu_int64, MAX_LINT64 - d) / 10)
+                return 0; /* overflow */
+            a = a * 10 + d;
+        }
+    }
+    while (isspace(cast(unsigned char, *s)))
+        s++;
+    if (empty || *s != '\0')
+        return 0;
+    *result = cast(l_int64, a);
+    return 1;
+}
+
 static void pushstr(lua_State *L, const char *str) {
     setsvalue2s(L, L->top, luaS_new(L, str));
     incr_top(L);
@@ -1,6 +1,7 @@
 #ifndef lobject_h
 #define lobject_h
 
+#include <cmath>
 #include <cstdarg>
 
 #include "llimits.h"
@@ -18,6 +19,9 @@
 #define LUA_TUPVAL (LAST_TAG + 2)
 #define LUA_TDEADKEY (LAST_TAG + 3)
 
+/* variant of LUA_TNUMBER holding an integer (see LUA_INTSUBTYPE) */
+#define LUA_TNUMINT (LUA_TNUMBER | (1 << 4))
+
 /*
 ** Union of all collectable objects
 */
@@ -41,6 +45,160 @@ struct GCheader {
     CommonHeader;
 };
 
+/*
+** LUA_NANBOXING selects an 8-byte value representation that keeps type
+** tags inside NaNs. It needs LUA_NUMBER double and pointers that fit in
+** 47 bits, as user-space pointers do on x86-64.
+*/
+#ifndef LUA_NANBOXING
+#define LUA_NANBOXING 0
+#endif
+
+/*
+** LUA_INTSUBTYPE gives numbers an integer variant: integral values are
+** kept as exact 64-bit integers while results fit, and turn into floats
+** on overflow and division. It does not fit in a NaN-boxed value.
+*/
+#ifndef LUA_INTSUBTYPE
+#define LUA_INTSUBTYPE 0
+#endif
+
+/*
+** LUA_SWISSTABLE replaces the chained hash part of tables with open
+** addressing: a byte of hash bits per node, probed a group at a time.
+*/
+#ifndef LUA_SWISSTABLE
+#define LUA_SWISSTABLE 0
+#endif
+
+/*
+** LUA_PACKEDARRAY keeps the array part of a table as raw numbers until a
+** value of another type is stored in it. A NaN-boxed value is already a
+** raw number, and an integer would lose its subtype, so the default
+** leaves it off in those configurations.
+*/
+#ifndef LUA_PACKEDARRAY
+#define LUA_PACKEDARRAY (!LUA_NANBOXING && !LUA_INTSUBTYPE)
+#endif
+
+#if LUA_PACKEDARRAY && (LUA_NANBOXING || LUA_INTSUBTYPE)
+#error "LUA_PACKEDARRAY needs plain double values"
+#endif
+
+#if LUA_NANBOXING && LUA_INTSUBTYPE
+#error "LUA_INTSUBTYPE cannot be used with LUA_NANBOXING"
+#endif
+
+#if LUA_NANBOXING
+
+/*
+** A value is either a double or a NaN with bits 47-50 holding its type
+** tag plus 1 and the low 47 bits holding the payload (a pointer or a
+** boolean). NaN numbers are all stored as NANBOX_BASE, whose tag field
+** is 0, so they cannot be taken for a tagged value.
+*/
+#define NANBOX_BASE 0xFFF8000000000000ULL
+#define NANBOX_PAYLOAD 0x00007FFFFFFFFFFFULL
+#define nanboxtag(t) (NANBOX_BASE | (cast(lu_int64, (t) + 1) << 47))
+#define NANBOX_NIL nanboxtag(LUA_TNIL)
+
+/*
+** Union of all Lua values
+*/
+union Value {
+    lu_int64 u;
+    lua_Number n;
+};
+
+/*
+** Tagged Values
+*/
+struct TValue {
+    Value value;
+
+    inline int type() const {
+        return (value.u < NANBOX_NIL) ? LUA_TNUMBER
+                                      : cast_int((value.u >> 47) & 0xF) - 1;
+    }
+    inline bool hastag(int t) const {
+        return (value.u & ~NANBOX_PAYLOAD) == nanboxtag(t);
+    }
+
+    inline bool isnil() const { return this->value.u == NANBOX_NIL; }
+    inline bool isnumber() const { return this->value.u < NANBOX_NIL; }
+    inline bool isstring() const { return hastag(LUA_TSTRING); }
+    inline bool istable() const { return hastag(LUA_TTABLE); }
+    inline bool isfunction() const { return hastag(LUA_TFUNCTION); }
+    inline bool isboolean() const { return hastag(LUA_TBOOLEAN); }
+    inline bool isuserdata() const { return hastag(LUA_TUSERDATA); }
+    inline bool isthread() const { return hastag(LUA_TTHREAD); }
+    inline bool islightuserdata() const {
+        return hastag(LUA_TLIGHTUSERDATA);
+    }
+
+    inline bool isfalse() const {
+        return this->isnil() || this->value.u == nanboxtag(LUA_TBOOLEAN);
+    }
+};
+
+static_assert(sizeof(TValue) == 8, "NaN boxing needs a double lua_Number");
+
+#define NILCONSTANT {{NANBOX_NIL}}
+
+/* Macros to access values */
+#define ttype(o) ((o)->type())
+#define gcvalue(o) cast(GCObject *, cast(size_t, (o)->value.u & NANBOX_PAYLOAD))
+#define pvalue(o) cast(void *, cast(size_t, (o)->value.u & NANBOX_PAYLOAD))
+#define nvalue(o) ((o)->value.n)
+#define bvalue(o) cast_int((o)->value.u & 1)
+
+/* Macros to set values */
+#define setnilvalue(obj) ((obj)->value.u = NANBOX_NIL)
+
+#define setnvalue(obj, x)                                                      \
+    {                                                                          \
+        TValue *i_o = (obj);                                                   \
+        lua_Number i_n = (x);                                                  \
+        if (luai_numisnan(i_n))                                                \
+            i_o->value.u = NANBOX_BASE;                                        \
+        else                                                                   \
+            i_o->value.n = i_n;                                                \
+    }
+
+#define setpvalue(obj, x)                                                      \
+    {                                                                          \
+        TValue *i_o = (obj);                                                   \
+        i_o->value.u = nanboxtag(LUA_TLIGHTUSERDATA) |                         \
+                       cast(lu_int64, cast(size_t, (x)));                      \
+    }
+
+#define setbvalue(obj, x)                                                      \
+    {                                                                          \
+        TValue *i_o = (obj);                                                   \
+        i_o->value.u = nanboxtag(LUA_TBOOLEAN) | ((x) != 0);                   \
+    }
+
+#define setgcovalue(obj, x, t)                                                 \
+    {                                                                          \
+        TValue *i_o = (obj);                                                   \
+        i_o->value.u = nanboxtag(t) | cast(lu_int64, cast(size_t, (x)));       \
+    }
+
+#define setobj(L, obj1, obj2)                                                  \
+    {                                                                          \
+        const TValue *o2 = (obj2);                                             \
+        TValue *o1 = (obj1);                                                   \
+        o1->value = o2->value;                                                 \
+    }
+
+/* change the type of a (collectable) value, keeping its payload */
+#define setttype(obj, tt)                                                      \
+    ((obj)->value.u = ((obj)->value.u & NANBOX_PAYLOAD) | nanboxtag(tt))
+
+#define rawtt(o) ttype(o)
+
+#else
+
 /*
 ** Union of all Lua values
 */
@@ -48,6 +206,7 @@ union Value {
     GCObject *gc;
     void *p;
     lua_Number n;
+    l_int64 i;
     int b;
 };
 
@@ -56,10 +215,14 @@ union Value {
 */
 struct TValue {
     Value value;
-    int tt;
+    lu_byte tt;
 
     inline bool isnil() const { return this->tt == LUA_TNIL; }
+#if LUA_INTSUBTYPE
+    inline bool isnumber() const { return (this->tt & 0x0F) == LUA_TNUMBER; }
+#else
     inline bool isnumber() const { return this->tt == LUA_TNUMBER; }
+#endif
     inline bool isstring() const { return this->tt == LUA_TSTRING; }
     inline bool istable() const { return this->tt == LUA_TTABLE; }
     inline bool isfunction() const { return this->tt == LUA_TFUNCTION; }
@@ -75,19 +238,23 @@ struct TValue {
     }
 };
 
+#define NILCONSTANT {{nullptr}, LUA_TNIL}
+
 /* Macros to access values */
+#if LUA_INTSUBTYPE
+#define ttype(o) ((o)->tt & 0x0F) /* number variants are all LUA_TNUMBER */
+#define ttisint(o) ((o)->tt == LUA_TNUMINT)
+#define ivalue(o) ((o)->value.i)
+#define fltvalue(o) ((o)->value.n)
+#define nvalue(o) (ttisint(o) ? cast_num(ivalue(o)) : fltvalue(o))
+#else
 #define ttype(o) ((o)->tt)
+#define nvalue(o) ((o)->value.n)
+#endif
+#define rawtt(o) ((o)->tt)
 #define gcvalue(o) ((o)->value.gc)
 #define pvalue(o) ((o)->value.p)
-#define nvalue(o) ((o)->value.n)
-#define rawtsvalue(o) (&(o)->value.gc->ts)
-#define tsvalue(o) (rawtsvalue(o))
-#define rawuvalue(o) (&(o)->value.gc->u)
-#define uvalue(o) (rawuvalue(o))
-#define clvalue(o) (&(o)->value.gc->cl)
-#define hvalue(o) (&(o)->value.gc->h)
 #define bvalue(o) ((o)->value.b)
-#define thvalue(o) (&(o)->value.gc->th)
 
 /* Macros to set values */
 #define setnilvalue(obj) ((obj)->tt = LUA_TNIL)
@@ -113,55 +280,53 @@ struct TValue {
         i_o->tt = LUA_TBOOLEAN;                                                \
     }
 
-#define setsvalue(L, obj, x)                                                   \
+#define setgcovalue(obj, x, t)                                                 \
     {                                                                          \
         TValue *i_o = (obj);                                                   \
         i_o->value.gc = cast(GCObject *, (x));                                 \
-        i_o->tt = LUA_TSTRING;                                                 \
+        i_o->tt = (t);                                                         \
     }
 
-#define setuvalue(L, obj, x)                                                   \
+#define setobj(L, obj1, obj2)                                                  \
     {                                                                          \
-        TValue *i_o = (obj);                                                   \
-        i_o->value.gc = cast(GCObject *, (x));                                 \
-        i_o->tt = LUA_TUSERDATA;                                               \
+        const TValue *o2 = (obj2);                                             \
+        TValue *o1 = (obj1);                                                   \
+        o1->value = o2->value;                                                 \
+        o1->tt = o2->tt;                                                       \
     }
 
-#define setthvalue(L, obj, x)                                                  \
+#if LUA_INTSUBTYPE
+#define setivalue(obj, x)                                                      \
     {                                                                          \
         TValue *i_o = (obj);                                                   \
-        i_o->value.gc = cast(GCObject *, (x));                                 \
-        i_o->tt = LUA_TTHREAD;                                                 \
+        i_o->value.i = (x);                                                    \
+        i_o->tt = LUA_TNUMINT;                                                 \
     }
+#endif
 
-#define setclvalue(L, obj, x)                                                  \
-    {                                                                          \
-        TValue *i_o = (obj);                                                   \
-        i_o->value.gc = cast(GCObject *, (x));                                 \
-        i_o->tt = LUA_TFUNCTION;                                               \
-    }
+#define setttype(obj, t) ((obj)->tt = (t))
 
-#define sethvalue(L, obj, x)                                                   \
-    {                                                                          \
-        TValue *i_o = (obj);                                                   \
-        i_o->value.gc = cast(GCObject *, (x));                                 \
-        i_o->tt = LUA_TTABLE;                                                  \
-    }
+#endif
 
-#define setptvalue(L, obj, x)                                                  \
-    {                                                                          \
-        TValue *i_o = (obj);                                                   \
-        i_o->value.gc = cast(GCObject *, (x));                                 \
-        i_o->tt = LUA_TPROTO;                                                  \
-    }
+#if !LUA_INTSUBTYPE
+/* without the integer variant, integers are just numbers */
+#define setivalue(obj, x) setnvalue(obj, cast_num(x))
+#endif
 
-#define setobj(L, obj1, obj2)                                                  \
-    {                                                                          \
-        const TValue *o2 = (obj2);                                             \
-        TValue *o1 = (obj1);                                                   \
-        o1->value = o2->value;                                                 \
-        o1->tt = o2->tt;                                                       \
-    }
+#define rawtsvalue(o) (&gcvalue(o)->ts)
+#define tsvalue(o) (rawtsvalue(o))
+#define rawuvalue(o) (&gcvalue(o)->u)
+#define uvalue(o) (rawuvalue(o))
+#define clvalue(o) (&gcvalue(o)->cl)
+#define hvalue(o) (&gcvalue(o)->h)
+#define thvalue(o) (&gcvalue(o)->th)
+
+#define setsvalue(L, obj, x) setgcovalue(obj, x, LUA_TSTRING)
+#define setuvalue(L, obj, x) setgcovalue(obj, x, LUA_TUSERDATA)
+#define setthvalue(L, obj, x) setgcovalue(obj, x, LUA_TTHREAD)
+#define setclvalue(L, obj, x) setgcovalue(obj, x, LUA_TFUNCTION)
+#define sethvalue(L, obj, x) setgcovalue(obj, x, LUA_TTABLE)
+#define setptvalue(L, obj, x) setgcovalue(obj, x, LUA_TPROTO)
 
 /*
 ** different types of sets, according to destination
@@ -182,10 +347,93 @@ struct TValue {
 #define setobj2n setobj
 #define setsvalue2n setsvalue
 
-#define setttype(obj, tt) (ttype(obj) = (tt))
-
 #define iscollectable(o) (ttype(o) >= LUA_TSTRING)
 
+/*
+** Exact integer arithmetic. Each operation returns 0 when the result
+** does not fit in an l_int64; the caller then computes it with floats.
+*/
+inline int luaO_intadd(l_int64 a, l_int64 b, l_int64 *r) {
+    l_int64 s = cast(l_int64, cast(lu_int64, a) + cast(lu_int64, b));
+    if (((a ^ s) & (b ^ s)) < 0) /* result sign differs from both? */
+        return 0;
+    *r = s;
+    return 1;
+}
+
+inline int luaO_intsub(l_int64 a, l_int64 b, l_int64 *r) {
+    l_int64 s = cast(l_int64, cast(lu_int64, a) - cast(lu_int64, b));
+    if (((a ^ b) & (a ^ s)) < 0)
+        return 0;
+    *r = s;
+    return 1;
+}
+
+inline int luaO_intmul(l_int64 a, l_int64 b, l_int64 *r) {
+#if defined(__GNUC__)
+    return !__builtin_mul_overflow(a, b, r);
+#else
+    if (a == -1) {
+        if (b == MIN_LINT64)
+            return 0;
+        *r = -b;
+        return 1;
+    }
+    l_int64 p = cast(l_int64, cast(lu_int64, a) * cast(lu_int64, b));
+    if (a != 0 && p / a != b)
+        return 0;
+    *r = p;
+    return 1;
+#endif
+}
+
+/* `a - floor(a/b)*b', as luai_nummod */
+inline int luaO_intmod(l_int64 a, l_int64 b, l_int64 *r) {
+    if (b == 0)
+        return 0; /* result is NaN */
+    if (b == -1) { /* avoid overflow with MIN_LINT64 % -1 */
+        *r = 0;
+        return 1;
+    }
+    l_int64 m = a % b;
+    if (m != 0 && (m ^ b) < 0) /* result must have the sign of `b' */
+        m += b;
+    *r = m;
+    return 1;
+}
+
+inline int luaO_intunm(l_int64 a, l_int64 *r) {
+    if (a == MIN_LINT64)
+        return 0;
+    *r = -a;
+    return 1;
+}
+
+/* integer with the same value as `n', if there is one */
+inline int luaO_flt2int(lua_Number n, l_int64 *i) {
+    if (n >= cast_num(MIN_LINT64) && n < -cast_num(MIN_LINT64) &&
+        n == floor(n)) {
+        *i = cast(l_int64, n);
+        return 1;
+    }
+    return 0;
+}
+
+#if LUA_INTSUBTYPE
+/* equality of two numbers of any variant, with no rounding */
+inline int luaO_numeq(const TValue *a, const TValue *b) {
+    l_int64 i;
+    if (ttisint(a) && ttisint(b))
+        return ivalue(a) == ivalue(b);
+    else if (ttisint(a))
+        return luaO_flt2int(fltvalue(b), &i) && i == ivalue(a);
+    else if (ttisint(b))
+        return luaO_flt2int(fltvalue(a), &i) && i == ivalue(b);
+    else
+        return fltvalue(a) == fltvalue(b);
+}
+#endif
+
 using StkId = TValue *; /* index to stack elements */
 
 /*
@@ -193,12 +441,41 @@ using StkId = TValue *; /* index to stack elements */
 */
 struct TString {
     CommonHeader;
-    lu_byte reserved;
+    lu_byte reserved; /* index of a reserved word, and the flags below */
     unsigned int hash;
     size_t len;
 };
 
-#define getstr(ts) cast(const char *, (ts) + 1)
+/*
+** bits of `reserved' above the index of a reserved word
+*/
+#define RESERVEDMASK 0x1F /* index of a reserved word (1-based) */
+#define STRLONG 0x20      /* longer than LUAI_MAXSHORTLEN: not interned */
+#define STRHASHED 0x40    /* `hash' is computed (always, for short strings) */
+#define STRINBUF 0x80     /* characters are in a `StrBuf' */
+
+#define isreserved(ts) ((ts)->reserved & RESERVEDMASK)
+#define islongstr(ts) ((ts)->reserved & STRLONG)
+#define ishashed(ts) ((ts)->reserved & STRHASHED)
+#define isinbuf(ts) ((ts)->reserved & STRINBUF)
+
+/*
+** characters of long strings built by concatenation. Each string uses a
+** prefix of `data'; the longest one can grow in place.
+*/
+struct StrBuf {
+    size_t size;    /* bytes in `data' */
+    size_t used;    /* length of the longest string */
+    int refs;       /* strings using it */
+    lu_byte sealed; /* `data[used]' must stay '\0' */
+    char data[1];
+};
+
+#define gbuf(ts) (*cast(StrBuf **, (ts) + 1))
+
+#define getstr(ts)                                                             \
+    (isinbuf(ts) ? cast(const char *, gbuf(ts)->data)                          \
+                 : cast(const char *, (ts) + 1))
 #define svalue(o) getstr(tsvalue(o))
 
 struct Udata {
@@ -208,6 +485,16 @@ struct Udata {
     size_t len;
 };
 
+struct LClosure;
+
+/*
+** loops of a function compiled ahead of time (see luaot.cpp): run the
+** function from instruction `pc' and return the instruction where the
+** interpreter goes on
+*/
+using AotCode = int (*)(lua_State *L, StkId base, TValue *k, LClosure *cl,
+                        int pc);
+
 /*
 ** Function Prototypes
 */
@@ -215,6 +502,9 @@ struct Proto {
     CommonHeader;
     TValue *k; /* constants used by the function */
     Instruction *code;
+    int *icache;            /* inline cache slots, one per instruction */
+    struct JitCode *jit;    /* machine code (see ljit.h) */
+    AotCode aot;            /* ahead-of-time compiled code, if any */
     struct Proto **p;       /* functions defined inside the function */
     int *lineinfo;          /* map from opcodes to source lines */
     struct LocVar *locvars; /* information about local variables */
@@ -223,9 +513,11 @@ struct Proto {
     int sizeupvalues;
     int sizek; /* size of `k' */
     int sizecode;
+    int sizeicache;
     int sizelineinfo;
     int sizep; /* size of `p' */
     int sizelocvars;
+    int hotcount; /* loop iterations left before compiling it */
     int linedefined;
     int lastlinedefined;
     GCObject *gclist;
@@ -294,25 +586,73 @@ union Closure {
 /*
 ** Tables
 */
-struct TKey : public TValue{
-    struct Node *next; /* for chaining */
-};
-
+#if LUA_NANBOXING
 struct Node {
     TValue i_val;
-    TKey i_key;
+    TValue i_key; /* a NaN-boxed key carries its own tag */
+#if !LUA_SWISSTABLE
+    int next; /* offset to the next node of the chain */
+#endif
+};
+#else
+/*
+** The tag of the key and the offset to the next node of the chain share
+** the word after the value with its tag; `u' mirrors the layout of i_val.
+*/
+union Node {
+    struct NodeKey {
+        Value value_;   /* fields of `i_val' */
+        lu_byte tt_;    /* fields of `i_val' */
+        lu_byte key_tt; /* tag of the key */
+        int next;       /* offset to the next node of the chain */
+        Value key_val;  /* value of the key */
+    } u;
+    TValue i_val; /* the value, as a proper TValue */
 };
+#endif
 
 struct Table {
     CommonHeader;
     lu_byte flags;     /* 1<<p means tagmethod(p) is not present */
     lu_byte lsizenode; /* log2 of size of `node' array */
+    lu_byte cached;    /* some cached `__index' resolution depends on it */
+#if LUA_PACKEDARRAY
+    lu_byte packed; /* `array' holds raw numbers (see ltable.h) */
+#endif
+    unsigned short site; /* 1 + constructor site in `tabsites', or 0 */
     Table *metatable;
     TValue *array; /* array part */
     Node *node;
+#if LUA_SWISSTABLE
+    int growthleft; /* keys that can be added before a rehash */
+#else
     Node *lastfree; /* any free position is before this position */
+#endif
+    struct OldHash *old; /* previous hash part, while it is moved */
     GCObject *gclist;
     int sizearray; /* size of `array' array */
+    unsigned int lenhint; /* last border found in the array part */
+    int nexthint;         /* node of the key `next' returned last */
+};
+
+/*
+** sizes that the tables built by an OP_NEWTABLE instruction had to grow
+** to, so that the next ones start with them
+*/
+struct TableSite {
+    const Instruction *pc; /* instruction that owns the entry */
+    lu_byte lasize;        /* 1 + log2 of array size, or 0 */
+    lu_byte lhsize;        /* 1 + log2 of the number of hashed keys, or 0 */
+};
+
+#define NUMSITES 256 /* must be a power of 2 */
+
+/*
+** the previous hash part of a table that grows incrementally, with the
+** nodes not yet moved to the new one
+*/
+struct OldHash : public Table {
+    int migrated; /* nodes before this index were already moved */
 };
 
 /*
@@ -333,6 +673,7 @@ LUAI_FUNC int luaO_log2(unsigned int x);
 LUAI_FUNC int luaO_int2fb(unsigned int x);
 LUAI_FUNC int luaO_fb2int(int x);
 LUAI_FUNC int luaO_rawequalObj(const TValue *t1, const TValue *t2);
+LUAI_FUNC int luaO_str2int(const char *s, l_int64 *result);
 LUAI_FUNC int luaO_str2d(const char *s, lua_Number *result);
 LUAI_FUNC const char *luaO_pushvfstring(lua_State *L, const char *fmt,
                                         va_list argp);
@@ -57,3 +57,22 @@ const lu_byte luaP_opmodes[NUM_OPCODES] = {
     opmode(0, 1, OpArgU, OpArgN, iABx),  /* OP_CLOSURE */
     opmode(0, 1, OpArgU, OpArgN, iABC),  /* OP_VARARG */
 };
+
+/* ORDER OP */
+const lu_byte luaP_baseop[NUM_VMOPCODES] = {
+    OP_MOVE,      OP_LOADK,     OP_LOADBOOL,  OP_LOADNIL,   OP_GETUPVAL,
+    OP_GETGLOBAL, OP_GETTABLE,  OP_SETGLOBAL, OP_SETUPVAL,  OP_SETTABLE,
+    OP_NEWTABLE,  OP_SELF,      OP_ADD,       OP_SUB,       OP_MUL,
+    OP_DIV,       OP_MOD,       OP_POW,       OP_UNM,       OP_NOT,
+    OP_LEN,       OP_CONCAT,    OP_JMP,       OP_EQ,        OP_LT,
+    OP_LE,        OP_TEST,      OP_TESTSET,   OP_CALL,      OP_TAILCALL,
+    OP_RETURN,    OP_FORLOOP,   OP_FORPREP,   OP_TFORLOOP,  OP_SETLIST,
+    OP_CLOSE,     OP_CLOSURE,   OP_VARARG,
+    /* specialized forms */
+    OP_ADD,       OP_SUB,       OP_MUL,       OP_DIV, /* OP_xxx_NN */
+    OP_ADD,       OP_SUB,       OP_MUL,       OP_DIV, /* OP_xxx_NK */
+    OP_LT,        OP_LE,                              /* OP_xx_NN */
+    /* superinstructions */
+    OP_GETTABLE,  OP_GETTABLE,  OP_GETGLOBAL, OP_SETTABLE,  OP_SELF,
+    OP_MOVE,
+};
@@ -184,11 +184,38 @@ enum OpCode {
     OP_CLOSE,   /*	A 	close all variables in the stack up to (>=) R(A)*/
     OP_CLOSURE, /*	A Bx	R(A) := closure(KPROTO[Bx], R(A), ... ,R(A+n))	*/
 
-    OP_VARARG /*	A B	R(A), R(A+1), ..., R(A+B-1) = vararg		*/
+    OP_VARARG, /*	A B	R(A), R(A+1), ..., R(A+B-1) = vararg		*/
+
+    /*----------------------------------------------------------------------
+    specialized (`quickened') forms: never generated by the compiler; the
+    VM rewrites an instruction in place into one of them after observing
+    its operands, and back into the original form when a guard fails
+    ------------------------------------------------------------------------*/
+    OP_ADD_NN, /*	A B C	R(A) := R(B) + R(C)	(numbers)		*/
+    OP_SUB_NN, /*	A B C	R(A) := R(B) - R(C)	(numbers)		*/
+    OP_MUL_NN, /*	A B C	R(A) := R(B) * R(C)	(numbers)		*/
+    OP_DIV_NN, /*	A B C	R(A) := R(B) / R(C)	(numbers)		*/
+    OP_ADD_NK, /*	A B C	R(A) := R(B) + Kst(C)	(numbers)		*/
+    OP_SUB_NK, /*	A B C	R(A) := R(B) - Kst(C)	(numbers)		*/
+    OP_MUL_NK, /*	A B C	R(A) := R(B) * Kst(C)	(numbers)		*/
+    OP_DIV_NK, /*	A B C	R(A) := R(B) / Kst(C)	(numbers)		*/
+    OP_LT_NN,  /*	A B C	if ((RK(B) <  RK(C)) ~= A) then pc++	(numbers)	*/
+    OP_LE_NN,  /*	A B C	if ((RK(B) <= RK(C)) ~= A) then pc++	(numbers)	*/
+    /* superinstructions: the first opcode of a pair that always follows
+       with the second one (which stays in place, see `luaK_fuse') */
+    OP_GETTABLE_GETTABLE,
+    OP_GETTABLE_CALL,
+    OP_GETGLOBAL_GETTABLE,
+    OP_SETTABLE_FORLOOP,
+    OP_SELF_CALL,
+    OP_MOVE_CALL
 };
 
 #define NUM_OPCODES (cast(int, OP_VARARG) + 1)
 
+/* number of opcodes understood by the VM (including specialized forms) */
+#define NUM_VMOPCODES (cast(int, OP_MOVE_CALL) + 1)
+
 /*===========================================================================
   Notes:
   (*) In OP_CALL, if (B == 0) then B = top. C is the number of returns - 1,
@@ -234,6 +261,19 @@ LUAI_DATA const lu_byte luaP_opmodes[NUM_OPCODES];
 
 LUAI_DATA const char *const luaP_opnames[NUM_OPCODES + 1]; /* opcode names */
 
+/* original opcode of each (possibly specialized) opcode */
+LUAI_DATA const lu_byte luaP_baseop[NUM_VMOPCODES];
+
+/*
+** undo any specialization done by the VM or by `luaK_fuse'; whoever
+** inspects live code (debug information, dumps) sees only the opcodes the
+** compiler generated
+*/
+inline Instruction luaP_unquicken(Instruction i) {
+    SET_OPCODE(i, luaP_baseop[GET_OPCODE(i)]);
+    return i;
+}
+
 /* number of list items to accumulate before a SETLIST instruction */
 #define LFIELDS_PER_FLUSH 50
 
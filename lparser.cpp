@@ -337,6 +337,8 @@ static void close_func(LexState *ls) {
     f->sizelocvars = fs->nlocvars;
     luaM_reallocvector<TString *>(L, &f->upvalues, f->sizeupvalues, f->nups);
     f->sizeupvalues = f->nups;
+    luaK_fuse(f);
+    luaF_initcache(L, f);
     ls->fs = fs->prev;
     L->top -= 2; /* remove table and prototype from the stack */
     /* last token read was anchored in defunct function; must reanchor it */
@@ -349,12 +351,16 @@ Proto *luaY_parser(lua_State *L, ZIO *z, Mbuffer *buff, const char *name) {
     FuncState funcstate;
     lexstate.buff = buff;
     luaX_setinput(L, &lexstate, z, luaS_new(L, name));
+    lexstate.h = luaH_new(L, 0, 0);
+    sethvalue2s(L, L->top, lexstate.h); /* anchor it */
+    incr_top(L);
     open_func(&lexstate, &funcstate);
     funcstate.f->is_vararg = VARARG_ISVARARG; /* main func. is always vararg */
     luaX_next(&lexstate);                     /* read first token */
     chunk(&lexstate);
     check(&lexstate, TK_EOS);
     close_func(&lexstate);
+    L->top--; /* remove `lexstate.h' */
     return funcstate.f;
 }
 
@@ -673,6 +679,11 @@ static void simpleexp(LexState *ls, expdesc *v) {
         v->u.nval = ls->t.seminfo.r;
         break;
     }
+    case TK_INT: {
+        init_exp(v, VKINT, 0);
+        v->u.ival = ls->t.seminfo.i;
+        break;
+    }
     case TK_STRING: {
         codestring(ls, v, ls->t.seminfo.ts);
         break;
@@ -1019,7 +1030,7 @@ static void fornum(LexState *ls, TString *varname, int line) {
     if (testnext(ls, ','))
         exp1(ls); /* optional step */
     else {        /* default step = 1 */
-        luaK_codeABx(fs, OP_LOADK, fs->freereg, luaK_numberK(fs, 1));
+        luaK_codeABx(fs, OP_LOADK, fs->freereg, luaK_intK(fs, 1));
         luaK_reserveregs(fs, 1);
     }
     forbody(ls, base, line, 1, 1);
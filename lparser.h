@@ -17,6 +17,7 @@ enum expkind{
     VFALSE,
     VK,         /* info = index of constant in `k' */
     VKNUM,      /* nval = numerical value */
+    VKINT,      /* ival = integer value */
     VLOCAL,     /* info = local register */
     VUPVAL,     /* info = index of upvalue in `upvalues' */
     VGLOBAL,    /* info = index of table; aux = index of global name in `k' */
@@ -35,6 +36,7 @@ struct expdesc {
             int info, aux;
         } s;
         lua_Number nval;
+        l_int64 ival;
     } u;
     int t; /* patch list of `exit when true' */
     int f; /* patch list of `exit when false' */
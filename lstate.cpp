@@ -1,3 +1,5 @@
+#include <ctime>
+
 #define lstate_c
 #define LUA_CORE
 
@@ -14,6 +16,22 @@
 #include "ltable.h"
 #include "ltm.h"
 
+/*
+** a seed for string hashes that differs between states and runs, so
+** that inputs cannot be built to collide: addresses change with ASLR, and
+** the time with each run. Define `luai_makeseed' for reproducible hashes.
+*/
+#ifndef luai_makeseed
+static unsigned int luai_makeseed(lua_State *L) {
+    size_t buff[3];
+    unsigned int h = cast(unsigned int, time(nullptr));
+    buff[0] = cast(size_t, L);
+    buff[1] = cast(size_t, &h);
+    buff[2] = cast(size_t, &luaS_hash);
+    return luaS_hash(cast(const char *, buff), sizeof(buff), h);
+}
+#endif
+
 /*
 ** Main thread combines a thread state and the global state
 */
@@ -86,6 +104,7 @@ static void close_state(lua_State *L) {
     luaF_close(L, L->stack); /* close all upvalues for this thread */
     luaC_freeall(L);         /* collect all objects */
     luaM_freearray<TString *>(L, G(L)->strt.hash, G(L)->strt.size);
+    luaM_freearray<TString *>(L, G(L)->strt.old, G(L)->strt.oldsize);
     luaZ_resizebuffer(L, &g->buff, 0);
     freestack(L, L);
     (*g->frealloc)(L, 0);
@@ -126,6 +145,7 @@ LUA_API lua_State *lua_newstate(lua_Alloc f) {
     set2bits(L->marked, FIXEDBIT, SFIXEDBIT);
     preinit_state(L, g);
     g->frealloc = f;
+    g->seed = luai_makeseed(L);
     g->mainthread = L;
     g->uvhead.u.l.prev = &g->uvhead;
     g->uvhead.u.l.next = &g->uvhead;
@@ -133,12 +153,18 @@ LUA_API lua_State *lua_newstate(lua_Alloc f) {
     g->strt.size = 0;
     g->strt.nuse = 0;
     g->strt.hash = nullptr;
+    g->strt.nfill = 0;
+    g->strt.old = nullptr;
+    g->strt.oldsize = 0;
+    g->strt.moved = 0;
+    g->strt.list = nullptr;
     setnilvalue(registry(L));
     g->buff = Mbuffer();
     g->panic = nullptr;
+    g->nextf = nullptr;
     g->gcstate = GCSpause;
     g->rootgc = obj2gco(L);
-    g->sweepstrgc = 0;
+    g->sweepstrgc = &g->strt.list;
     g->sweepgc = &g->rootgc;
     g->gray = nullptr;
     g->grayagain = nullptr;
@@ -150,6 +176,8 @@ LUA_API lua_State *lua_newstate(lua_Alloc f) {
     g->gcdept = 0;
     for (int i = 0; i < NUM_TAGS; i++)
         g->mt[i] = nullptr;
+    for (int i = 0; i < NUMSITES; i++)
+        g->tabsites[i].pc = nullptr;
     if (luaD_rawrunprotected(L, f_luaopen, nullptr) != 0) {
         /* memory allocation error: free partial state */
         close_state(L);
@@ -22,10 +22,19 @@ struct lua_longjmp; /* defined in ldo.c */
 
 #define BASIC_STACK_SIZE (2 * LUA_MINSTACK)
 
+/*
+** short strings, found by linear probing in `hash'. A resize moves the
+** strings of `old' into `hash' a few at a time, as new ones are added.
+*/
 struct stringtable {
-    GCObject **hash;
+    TString **hash;
     lu_int32 nuse; /* number of elements */
     int size;
+    int nfill;      /* slots of `hash' that are not empty */
+    TString **old;  /* slots still to be moved, or nullptr */
+    int oldsize;
+    int moved;      /* slots of `old' already moved */
+    GCObject *list; /* all the strings, linked by `next' */
 };
 
 /*
@@ -51,16 +60,17 @@ struct CallInfo {
 struct global_State {
     stringtable strt;   /* hash table for strings */
     lua_Alloc frealloc; /* function to reallocate memory */
+    unsigned int seed;  /* randomized seed for string hashes */
     lu_byte currentwhite;
-    lu_byte gcstate;     /* state of garbage collector */
-    int sweepstrgc;      /* position of sweep in `strt' */
-    GCObject *rootgc;    /* list of all collectable objects */
-    GCObject **sweepgc;  /* position of sweep in `rootgc' */
-    GCObject *gray;      /* list of gray objects */
-    GCObject *grayagain; /* list of objects to be traversed atomically */
-    GCObject *weak;      /* list of weak tables (to be cleared) */
-    GCObject *tmudata;   /* last element of list of userdata to be GC */
-    Mbuffer buff;        /* temporary buffer for string concatentation */
+    lu_byte gcstate;       /* state of garbage collector */
+    GCObject **sweepstrgc; /* position of sweep in `strt.list' */
+    GCObject *rootgc;      /* list of all collectable objects */
+    GCObject **sweepgc;    /* position of sweep in `rootgc' */
+    GCObject *gray;        /* list of gray objects */
+    GCObject *grayagain;   /* list of objects to be traversed atomically */
+    GCObject *weak;        /* list of weak tables (to be cleared) */
+    GCObject *tmudata;     /* last element of list of userdata to be GC */
+    Mbuffer buff;          /* temporary buffer for string concatentation */
     lu_mem GCthreshold;
     lu_mem totalbytes;   /* number of bytes currently allocated */
     lu_mem estimate;     /* an estimate of number of bytes actually in use */
@@ -68,11 +78,15 @@ struct global_State {
     int gcpause;         /* size of pause between successive GCs */
     int gcstepmul;       /* GC `granularity' */
     lua_CFunction panic; /* to be called in unprotected errors */
+    lua_CFunction nextf; /* `next', which OP_TFORLOOP runs inline */
     TValue l_registry;
     struct lua_State *mainthread;
     UpVal uvhead; /* head of double-linked list of all open upvalues */
     struct Table *mt[NUM_TAGS]; /* metatables for basic types */
     TString *tmname[TM_N];      /* array with tag-method names */
+    unsigned int idxversion;    /* current version of `idxcache' */
+    IndexCache idxcache[INDEXCACHESIZE];
+    TableSite tabsites[NUMSITES]; /* see `luaH_newat' */
 };
 
 /*
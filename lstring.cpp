@@ -10,74 +10,307 @@
 #include "lstate.h"
 #include "lstring.h"
 
-void luaS_resize(lua_State *L, int newsize) {
-    GCObject **newhash;
-    stringtable *tb;
+/* slots of `old' moved to `hash' for each new string */
+#define MOVESTEP 8
+
+/* fills the slot of a removed string, so that searches go past it */
+static TString deadstr_;
+#define DEADSTR (&deadstr_)
+
+/* puts `ts' in the first slot of its probe sequence that holds no string */
+static void place(stringtable *tb, TString *ts) {
+    int i = lmod(ts->hash, tb->size);
+    while (tb->hash[i] != nullptr && tb->hash[i] != DEADSTR)
+        i = (i + 1) & (tb->size - 1);
+    if (tb->hash[i] == nullptr)
+        tb->nfill++;
+    tb->hash[i] = ts;
+}
+
+static void movestrings(lua_State *L, stringtable *tb, int n) {
+    for (; n > 0 && tb->moved < tb->oldsize; n--, tb->moved++) {
+        TString *ts = tb->old[tb->moved];
+        if (ts != nullptr && ts != DEADSTR) {
+            tb->old[tb->moved] = DEADSTR; /* keep its probe sequence */
+            place(tb, ts);
+        }
+    }
+    if (tb->moved == tb->oldsize) { /* all moved? */
+        luaM_freearray<TString *>(L, tb->old, tb->oldsize);
+        tb->old = nullptr;
+        tb->oldsize = 0;
+    }
+}
 
-    if (G(L)->gcstate == GCSsweepstring)
-        return; /* cannot resize during GC traverse */
-    newhash = luaM_newvector<GCObject *>(L, newsize);
-    tb = &G(L)->strt;
+/*
+** starts moving the strings to a new vector of `newsize' slots, which
+** must hold at least twice the strings in use. The strings left by a
+** previous resize go there at once.
+*/
+void luaS_resize(lua_State *L, int newsize) {
+    stringtable *tb = &G(L)->strt;
+    TString **newhash = luaM_newvector<TString *>(L, newsize);
     for (int i = 0; i < newsize; i++)
         newhash[i] = nullptr;
-    /* rehash */
-    for (int i = 0; i < tb->size; i++) {
-        GCObject *p = tb->hash[i];
-        while (p) {                       /* for each node in the list */
-            GCObject *next = p->gch.next; /* save next */
-            unsigned int h = gco2ts(p)->hash;
-            int h1 = lmod(h, newsize); /* new position */
-            p->gch.next = newhash[h1]; /* chain it */
-            newhash[h1] = p;
-            p = next;
+    TString **pending = tb->old;
+    int npending = tb->oldsize;
+    int from = tb->moved;
+    tb->old = tb->hash;
+    tb->oldsize = tb->size;
+    tb->moved = 0;
+    tb->hash = newhash;
+    tb->size = newsize;
+    tb->nfill = 0;
+    if (pending != nullptr) {
+        for (int i = from; i < npending; i++) {
+            if (pending[i] != nullptr && pending[i] != DEADSTR)
+                place(tb, pending[i]);
         }
+        luaM_freearray<TString *>(L, pending, npending);
     }
-    luaM_freearray<TString *>(L, tb->hash, tb->size);
-    tb->size = newsize;
-    tb->hash = newhash;
 }
 
-static TString *newlstr(lua_State *L, const char *str, size_t l,
+static TString **findslot(TString **v, int size, TString *ts) {
+    for (int i = lmod(ts->hash, size);; i = (i + 1) & (size - 1)) {
+        if (v[i] == ts)
+            return &v[i];
+        if (v[i] == nullptr)
+            return nullptr;
+    }
+}
+
+/*
+** takes a collected string out of the table
+*/
+void luaS_remove(lua_State *L, TString *ts) {
+    stringtable *tb = &G(L)->strt;
+    TString **p = findslot(tb->hash, tb->size, ts);
+    if (p == nullptr) /* not moved yet? */
+        p = findslot(tb->old, tb->oldsize, ts);
+    *p = DEADSTR;
+    tb->nuse--;
+}
+
+static TString *findstr(TString **v, int size, const char *str, size_t l,
                         unsigned int h) {
+    for (int i = lmod(h, size);; i = (i + 1) & (size - 1)) {
+        TString *ts = v[i];
+        if (ts == nullptr)
+            return nullptr;
+        if (ts != DEADSTR && ts->hash == h && ts->len == l &&
+            memcmp(str, getstr(ts), l) == 0)
+            return ts;
+    }
+}
+
+static inline lu_int64 rotl(lu_int64 x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+/*
+** hash of all the bytes of a string, taken a 64-bit word at a time;
+** the seed makes collisions depend on the state
+*/
+unsigned int luaS_hash(const char *str, size_t l, unsigned int seed) {
+    lu_int64 h = seed ^ (cast(lu_int64, l) * 0x9E3779B97F4A7C15ULL);
+    lu_int64 w;
+    for (; l >= sizeof(w); l -= sizeof(w), str += sizeof(w)) {
+        memcpy(&w, str, sizeof(w));
+        h = rotl(h ^ (w * 0x87C37B91114253D5ULL), 31) * 0x4CF5AD432745937FULL;
+    }
+    w = 0;
+    memcpy(&w, str, l); /* last bytes */
+    h ^= w * 0x87C37B91114253D5ULL;
+    h ^= h >> 33; /* final mix, so that every bit counts in every one */
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    return cast(unsigned int, h ^ (h >> 33));
+}
+
+/*
+** a long string keeps the seed in `hash' until it is needed as a key
+*/
+unsigned int luaS_hashlong(TString *ts) {
+    ts->hash = luaS_hash(getstr(ts), ts->len, ts->hash);
+    ts->reserved |= STRHASHED;
+    return ts->hash;
+}
+
+int luaS_eqlngstr(TString *a, TString *b) {
+    return a->len == b->len && memcmp(getstr(a), getstr(b), a->len) == 0;
+}
+
+static TString *createstr(lua_State *L, const char *str, size_t l) {
     if (l + 1 > (MAX_SIZET - sizeof(TString)) / sizeof(char))
         luaM_toobig(L);
     TString *ts = cast(
         TString *, luaM_malloc(L, (l + 1) * sizeof(char) + sizeof(TString)));
     ts->len = l;
-    ts->hash = h;
     ts->marked = luaC_white(G(L));
     ts->tt = LUA_TSTRING;
-    ts->reserved = 0;
     memcpy(ts + 1, str, l * sizeof(char));
     ((char *)(ts + 1))[l] = '\0'; /* ending 0 */
+    return ts;
+}
+
+static TString *newlstr(lua_State *L, const char *str, size_t l,
+                        unsigned int h) {
     stringtable *tb = &G(L)->strt;
-    h = lmod(h, tb->size);
-    ts->next = tb->hash[h]; /* chain new entry */
-    tb->hash[h] = obj2gco(ts);
+    if (tb->old != nullptr)
+        movestrings(L, tb, MOVESTEP);
+    if (tb->nfill >= tb->size - tb->size / 4) { /* too crowded? */
+        int newsize = tb->size; /* same size if most slots are dead */
+        while (cast(lu_int32, newsize) < 2 * tb->nuse && newsize <= MAX_INT / 2)
+            newsize *= 2;
+        luaS_resize(L, newsize);
+    }
+    TString *ts = createstr(L, str, l);
+    ts->reserved = STRHASHED;
+    ts->hash = h;
+    ts->next = tb->list;
+    tb->list = obj2gco(ts);
+    place(tb, ts);
     tb->nuse++;
-    if (tb->nuse > cast(lu_int32, tb->size) && tb->size <= MAX_INT / 2)
-        luaS_resize(L, tb->size * 2); /* too crowded */
     return ts;
 }
 
 TString *luaS_newlstr(lua_State *L, const char *str, size_t l) {
-    unsigned int h = cast(unsigned int, l); /* seed */
-    size_t step =
-        (l >> 5) + 1; /* if string is too long, don't hash all its chars */
-
-    for (size_t l1 = l; l1 >= step; l1 -= step) /* compute hash */
-        h = h ^ ((h << 5) + (h >> 2) + cast(unsigned char, str[l1 - 1]));
-    for (GCObject *o = G(L)->strt.hash[lmod(h, G(L)->strt.size)]; o != nullptr;
-         o = o->gch.next) {
-        TString *ts = rawgco2ts(o);
-        if (ts->len == l && (memcmp(str, getstr(ts), l) == 0)) {
-            /* string may be dead */
-            if (isdead(G(L), o))
-                changewhite(o);
-            return ts;
+    if (l > LUAI_MAXSHORTLEN) { /* long string? */
+        TString *ts = createstr(L, str, l);
+        ts->reserved = STRLONG;
+        ts->hash = G(L)->seed;
+        luaC_link(L, obj2gco(ts), LUA_TSTRING); /* swept like a table */
+        return ts;
+    }
+    stringtable *tb = &G(L)->strt;
+    unsigned int h = luaS_hash(str, l, G(L)->seed);
+    TString *ts = findstr(tb->hash, tb->size, str, l, h);
+    if (ts == nullptr && tb->old != nullptr)
+        ts = findstr(tb->old, tb->oldsize, str, l, h);
+    if (ts == nullptr)
+        return newlstr(L, str, l, h); /* not found */
+    if (isdead(G(L), obj2gco(ts))) /* string may be dead */
+        changewhite(obj2gco(ts));
+    return ts;
+}
+
+void luaS_free(lua_State *L, TString *ts) {
+    if (isinbuf(ts)) {
+        StrBuf *b = gbuf(ts);
+        if (b != nullptr && --b->refs == 0)
+            luaM_freemem(L, b, sizeof(StrBuf) + b->size - 1);
+    } else if (!islongstr(ts))
+        luaS_remove(L, ts);
+    luaM_freemem(L, ts, sizestring(ts));
+}
+
+static void setbuf(lua_State *L, TString *ts, StrBuf *b) {
+    StrBuf *old = gbuf(ts);
+    b->refs++;
+    gbuf(ts) = b;
+    if (old != nullptr && --old->refs == 0)
+        luaM_freemem(L, old, sizeof(StrBuf) + old->size - 1);
+}
+
+/* a buffer of `size' bytes holding a copy of the `l' characters of `s' */
+static StrBuf *newbuf(lua_State *L, const char *s, size_t l, size_t size) {
+    if (size > MAX_SIZET - sizeof(StrBuf))
+        luaM_toobig(L);
+    StrBuf *b = cast(StrBuf *, luaM_malloc(L, sizeof(StrBuf) + size - 1));
+    b->size = size;
+    b->used = l;
+    b->refs = 0;
+    b->sealed = 0;
+    memcpy(b->data, s, l);
+    b->data[l] = '\0';
+    return b;
+}
+
+/* a long string of length `l' whose buffer is still to be set */
+static TString *newbufstr(lua_State *L, size_t l) {
+    TString *ts = cast(TString *,
+                       luaM_malloc(L, sizeof(TString) + sizeof(StrBuf *)));
+    ts->len = l;
+    ts->reserved = STRLONG | STRINBUF;
+    ts->hash = G(L)->seed;
+    gbuf(ts) = nullptr;
+    luaC_link(L, obj2gco(ts), LUA_TSTRING);
+    return ts;
+}
+
+/*
+** a new long string of length `l' > `s->len' that starts with the
+** characters of `s'; the caller writes the others. If `s' is the longest
+** string of its buffer, they go in place after it, so that repeated
+** appends copy each character only a constant number of times.
+*/
+TString *luaS_extend(lua_State *L, TString *s, size_t l) {
+    TString *ts = newbufstr(L, l);
+    StrBuf *b = isinbuf(s) ? gbuf(s) : nullptr;
+    if (b == nullptr || b->sealed || b->used != s->len || l >= b->size) {
+        if (l >= (MAX_SIZET - sizeof(StrBuf)) / 3 * 2)
+            luaM_toobig(L);
+        b = newbuf(L, getstr(s), s->len, l + l / 2 + 1);
+    }
+    setbuf(L, ts, b);
+    b->used = l;
+    b->data[l] = '\0';
+    return ts;
+}
+
+/*
+** the characters of `ts' followed by a '\0' that no later append will
+** overwrite
+*/
+const char *luaS_flatten(lua_State *L, TString *ts) {
+    if (isinbuf(ts)) {
+        StrBuf *b = gbuf(ts);
+        if (b->used == ts->len)
+            b->sealed = 1; /* no more appends in place */
+        else {             /* the '\0' of `ts' was overwritten */
+            b = newbuf(L, getstr(ts), ts->len, ts->len + 1);
+            b->sealed = 1;
+            setbuf(L, ts, b);
         }
     }
-    return newlstr(L, str, l, h); /* not found */
+    return getstr(ts);
+}
+
+/*
+** strings being written by `luaL_Buffer': their only reference is on the
+** stack, so the buffer may move until `luaS_closebuf' fixes the length
+*/
+TString *luaS_newbuf(lua_State *L, size_t size) {
+    TString *ts = newbufstr(L, 0);
+    setbuf(L, ts, newbuf(L, "", 0, size + 1));
+    return ts;
+}
+
+char *luaS_growbuf(lua_State *L, TString *ts, size_t size) {
+    StrBuf *b = gbuf(ts);
+    if (size >= MAX_SIZET - sizeof(StrBuf))
+        luaM_toobig(L);
+    b = cast(StrBuf *, luaM_realloc_(L, b, sizeof(StrBuf) + b->size - 1,
+                                     sizeof(StrBuf) + size));
+    b->size = size + 1;
+    gbuf(ts) = b;
+    return b->data;
+}
+
+TString *luaS_closebuf(lua_State *L, TString *ts, size_t len) {
+    if (len <= LUAI_MAXSHORTLEN) /* short strings must be interned */
+        return luaS_newlstr(L, getstr(ts), len);
+    StrBuf *b = gbuf(ts);
+    if (b->size > len + 1) /* give back the unused space */
+        b = cast(StrBuf *, luaM_realloc_(L, b, sizeof(StrBuf) + b->size - 1,
+                                         sizeof(StrBuf) + len));
+    b->size = len + 1;
+    b->used = len;
+    b->data[len] = '\0';
+    gbuf(ts) = b;
+    ts->len = len;
+    return ts;
 }
 
 Udata *luaS_newudata(lua_State *L, size_t s, Table *e) {
@@ -5,7 +5,9 @@
 #include "lobject.h"
 #include "lstate.h"
 
-#define sizestring(s) (sizeof(TString) + ((s)->len + 1) * sizeof(char))
+#define sizestring(s)                                                          \
+    (isinbuf(s) ? sizeof(TString) + sizeof(StrBuf *)                           \
+                : sizeof(TString) + ((s)->len + 1) * sizeof(char))
 
 #define sizeudata(u) (sizeof(Udata) + (u)->len)
 
@@ -15,7 +17,23 @@
 
 #define luaS_fix(s) l_setbit((s)->marked, FIXEDBIT)
 
+/* short strings are interned, so only long ones need their contents read */
+#define luaS_eqstr(a, b) ((a) == (b) || (islongstr(a) && luaS_eqlngstr(a, b)))
+
+#define luaS_hashof(s) (ishashed(s) ? (s)->hash : luaS_hashlong(s))
+
+LUAI_FUNC unsigned int luaS_hash(const char *str, size_t l,
+                                 unsigned int seed);
+LUAI_FUNC unsigned int luaS_hashlong(TString *ts);
+LUAI_FUNC int luaS_eqlngstr(TString *a, TString *b);
 LUAI_FUNC void luaS_resize(lua_State *L, int newsize);
+LUAI_FUNC void luaS_remove(lua_State *L, TString *ts);
+LUAI_FUNC void luaS_free(lua_State *L, TString *ts);
+LUAI_FUNC TString *luaS_extend(lua_State *L, TString *s, size_t l);
+LUAI_FUNC const char *luaS_flatten(lua_State *L, TString *ts);
+LUAI_FUNC TString *luaS_newbuf(lua_State *L, size_t size);
+LUAI_FUNC char *luaS_growbuf(lua_State *L, TString *ts, size_t size);
+LUAI_FUNC TString *luaS_closebuf(lua_State *L, TString *ts, size_t len);
 LUAI_FUNC Udata *luaS_newudata(lua_State *L, size_t s, Table *e);
 LUAI_FUNC TString *luaS_newlstr(lua_State *L, const char *str, size_t l);
 
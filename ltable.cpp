@@ -9,6 +9,15 @@
 ** in its main position (i.e. the `original' position that its hash gives
 ** to it), then the colliding element is in its own main position.
 ** Hence even when the load factor reaches 100%, performance remains good.
+** With LUA_SWISSTABLE the hash part is open addressed instead: a control
+** byte per node keeps 7 bits of the hash of its key, and lookups compare
+** a whole group of control bytes at once before touching any node.
+** Large hash parts grow incrementally: the old node vector is kept aside
+** (`t->old') and each insertion moves a few of its nodes to the new one.
+** Lookups check the old nodes after the new ones; they never move nodes,
+** so a traversal sees every key once unless keys are added meanwhile.
+** With LUA_PACKEDARRAY the array part holds raw numbers until some other
+** value must go into it; only then is it turned into TValues (`unpack').
 */
 #include <cmath>
 #include <cstring>
@@ -24,7 +33,13 @@
 #include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
+#include "lstring.h"
 #include "ltable.h"
+#include "ltm.h"
+
+#if LUA_SWISSTABLE && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /*
 ** max size of array part is 2^MAXBITS
@@ -33,40 +48,217 @@
 
 #define MAXASIZE (1 << MAXBITS)
 
-#define hashpow2(t, n) (gnode(t, lmod((n), sizenode(t))))
+/*
+** constructor sites never presize a part beyond 2^MAXSITEBITS
+*/
+#define MAXSITEBITS 10
 
-#define hashstr(t, str) hashpow2(t, (str)->hash)
-#define hashboolean(t, p) hashpow2(t, p)
+/*
+** raw hash bits of a lua_Number: an integral one hashes as its integer
+** value (which also merges -0 with 0), any other one by its whole
+** representation
+*/
+static lu_int64 numbits(lua_Number n) {
+    int i;
+    lua_number2int(i, n);
+    if (luai_numeq(cast_num(i), n))
+        return cast(lu_int64, cast(unsigned int, i));
+    lu_int64 u = 0;
+    memcpy(&u, &n, sizeof(n) < sizeof(u) ? sizeof(n) : sizeof(u));
+    return u;
+}
 
 /*
-** for some types, it is better to avoid modulus by power of 2, as
-** they tend to have many 2 factors.
+** raw hash bits of a pointer, all of them
 */
-#define hashmod(t, n) (gnode(t, ((n) % ((sizenode(t) - 1) | 1))))
+#define pointbits(p) cast(lu_int64, cast(lu_mem, (p)))
 
-#define hashpointer(t, p) hashmod(t, IntPoint(p))
+/*
+** spread the raw bits of a key over the whole hash: fold the high half
+** onto the low one, then keep the high half of a multiplication by 2^64
+** over the golden ratio, so that every bit of the key counts
+*/
+static inline unsigned int mixhash(lu_int64 h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    return cast(unsigned int, h ^ (h >> 33));
+}
 
+#if LUA_INTSUBTYPE
 /*
-** number of ints inside a lua_Number
+** raw hash bits of an integer
 */
-#define numints cast_int(sizeof(lua_Number) / sizeof(int))
+static inline lu_int64 intbits(l_int64 i) {
+    return cast(lu_int64, i);
+}
 
-#define dummynode (&dummynode_)
+/*
+** keys with an integral float value are stored as integers, so that
+** `t[1]' and `t[1.0]' are the same entry
+*/
+static const TValue *normkey(const TValue *key, TValue *aux) {
+    l_int64 i;
+    if (key->isnumber() && !ttisint(key) && luaO_flt2int(fltvalue(key), &i)) {
+        setivalue(aux, i);
+        return aux;
+    }
+    return key;
+}
+#endif
+
+/* a free node */
+#if !LUA_NANBOXING
+#define EMPTYNODE {{{nullptr}, LUA_TNIL, LUA_TNIL, 0, {nullptr}}}
+#elif LUA_SWISSTABLE
+#define EMPTYNODE {NILCONSTANT, NILCONSTANT}
+#else
+#define EMPTYNODE {NILCONSTANT, NILCONSTANT, 0}
+#endif
+
+static inline bool equalkey(const Node *n, const TValue *key) {
+    TValue k;
+    getnodekey(L, &k, n);
+    return luaO_rawequalObj(&k, key);
+}
+
+/*
+** whether node `n' holds `key' or, with `dead', held it before it was
+** collected: `next' may still be called with such a key
+*/
+static inline bool samekey(const Node *n, const TValue *key, int dead) {
+    if (dead)
+        return keyisdead(n) && gckey(n) == gcvalue(key);
+    return equalkey(n, key);
+}
+
+#if LUA_SWISSTABLE
+
+/*
+** control bytes: 0x80 plus the low 7 bits of the hash for a node in use,
+** CTRL_EMPTY for a free node and CTRL_PAD for the padding of small tables
+*/
+#define CTRL_PAD 0
+#define CTRL_EMPTY 1
+
+#define ctrlbyte(h) cast_byte(0x80 | ((h)&0x7F))
+
+/*
+** nodes are probed a group at a time, from the group given by the rest of
+** the hash; triangular steps between groups visit all of them
+*/
+#define numgroups(t) (ctrlsize((t)->lsizenode) / GROUPSIZE)
+#define firstgroup(t, h) (cast_int((h) >> 7) & (numgroups(t) - 1))
+
+/*
+** a table without hash part still has a group of control bytes
+*/
+struct DummyHash {
+    Node n;
+    lu_byte ctrl[GROUPSIZE];
+};
+
+static const DummyHash dummyhash_ = {EMPTYNODE, {CTRL_PAD}};
 
-static const Node dummynode_ = {{}, /* value */ {} /* key */};
+#define dummynode (&dummyhash_.n)
 
 /*
-** hash for lua_Numbers
+** bit mask of the bytes in group `g' equal to `b'
 */
-static Node *hashnum(const Table *t, lua_Number n) {
-    unsigned int a[numints];
-    n += 1; /* normalize number (avoid -0) */
-    memcpy(a, &n, sizeof(a));
-    for (int i = 1; i < numints; i++)
-        a[0] += a[i];
-    return hashmod(t, a[0]);
+#if defined(__SSE2__)
+static inline unsigned int matchbyte(const lu_byte *g, lu_byte b) {
+    __m128i v = _mm_loadu_si128(cast(const __m128i *, g));
+    __m128i m = _mm_cmpeq_epi8(v, _mm_set1_epi8(cast(char, b)));
+    return cast(unsigned int, _mm_movemask_epi8(m));
+}
+#else
+static inline unsigned int matchbyte(const lu_byte *g, lu_byte b) {
+    unsigned int m = 0;
+    for (int i = 0; i < GROUPSIZE; i++)
+        m |= cast(unsigned int, g[i] == b) << i;
+    return m;
+}
+#endif
+
+#if defined(__GNUC__)
+#define lowbit(m) __builtin_ctz(m)
+#else
+static inline int lowbit(unsigned int m) {
+    int i = 0;
+    for (; !(m & 1); m >>= 1)
+        i++;
+    return i;
+}
+#endif
+
+static unsigned int hashkey(const TValue *key) {
+    switch (ttype(key)) {
+    case LUA_TNUMBER:
+#if LUA_INTSUBTYPE
+        if (ttisint(key))
+            return mixhash(intbits(ivalue(key)));
+#endif
+        return mixhash(numbits(nvalue(key)));
+    case LUA_TSTRING:
+        return mixhash(luaS_hashof(rawtsvalue(key)));
+    case LUA_TBOOLEAN:
+        return mixhash(bvalue(key));
+    case LUA_TLIGHTUSERDATA:
+        return mixhash(pointbits(pvalue(key)));
+    default:
+        return mixhash(pointbits(gcvalue(key)));
+    }
 }
 
+/*
+** returns the first node in the probe sequence of hash `h' for which
+** `eq' holds, or nullptr. Nodes never leave the hash part before a
+** rehash, so the search can stop at the first group with a free node.
+*/
+template <typename Eq>
+static inline Node *probe(const Table *t, unsigned int h, Eq eq) {
+    lu_byte c = ctrlbyte(h);
+    int mask = numgroups(t) - 1;
+    int g = firstgroup(t, h);
+    for (int step = 1;; step++) {
+        const lu_byte *ctrl = gctrl(t) + g * GROUPSIZE;
+        for (unsigned int m = matchbyte(ctrl, c); m != 0; m &= m - 1) {
+            Node *n = gnode(t, g * GROUPSIZE + lowbit(m));
+            if (eq(n))
+                return n;
+        }
+        if (matchbyte(ctrl, CTRL_EMPTY) != 0 || step > mask)
+            return nullptr;
+        g = (g + step) & mask;
+    }
+}
+
+static Node *findnode(const Table *t, const TValue *key, int dead) {
+    return probe(t, hashkey(key),
+                 [key, dead](const Node *n) { return samekey(n, key, dead); });
+}
+
+#else
+
+#define hashpow2(t, n) (gnode(t, lmod((n), sizenode(t))))
+
+#define hashstr(t, str) hashpow2(t, luaS_hashof(str))
+#define hashboolean(t, p) hashpow2(t, p)
+
+/*
+** numbers and pointers tend to have many 2 factors, so they are mixed
+** before the power of 2 modulus
+*/
+#define hashpointer(t, p) hashpow2(t, mixhash(pointbits(p)))
+
+#define hashnum(t, n) hashpow2(t, mixhash(numbits(n)))
+#define hashint(t, i) hashpow2(t, mixhash(intbits(i)))
+
+#define dummynode (&dummynode_)
+
+static const Node dummynode_ = EMPTYNODE;
+
 /*
 ** returns the `main' position of an element in a table (that is, the index
 ** of its hash value)
@@ -74,6 +266,10 @@ static Node *hashnum(const Table *t, lua_Number n) {
 static Node *mainposition(const Table *t, const TValue *key) {
     switch (ttype(key)) {
     case LUA_TNUMBER:
+#if LUA_INTSUBTYPE
+        if (ttisint(key))
+            return hashint(t, ivalue(key));
+#endif
         return hashnum(t, nvalue(key));
     case LUA_TSTRING:
         return hashstr(t, rawtsvalue(key));
@@ -86,11 +282,80 @@ static Node *mainposition(const Table *t, const TValue *key) {
     }
 }
 
+static Node *findnode(const Table *t, const TValue *key, int dead) {
+    Node *n = mainposition(t, key);
+    for (;;) { /* check whether `key' is somewhere in the chain */
+        if (samekey(n, key, dead))
+            return n;
+        if (gnext(n) == 0)
+            return nullptr;
+        n += gnext(n);
+    }
+}
+
+#endif
+
+#if LUA_SWISSTABLE
+/*
+** number of groups probed to find node `n' (1 for its first group)
+*/
+static int probelength(const Table *t, const Node *n) {
+    TValue k;
+    getnodekey(L, &k, n);
+    unsigned int h = hashkey(&k);
+    int mask = numgroups(t) - 1;
+    int g = firstgroup(t, h);
+    int target = cast_int(n - t->node) / GROUPSIZE;
+    int len = 1;
+    for (int step = 1; g != target; step++, len++)
+        g = (g + step) & mask;
+    return len;
+}
+#else
+/*
+** number of nodes visited to find node `n' (1 in its main position)
+*/
+static int probelength(const Table *t, const Node *n) {
+    TValue k;
+    getnodekey(L, &k, n);
+    const Node *mp = mainposition(t, &k);
+    int len = 1;
+    for (; mp != n; mp += gnext(mp))
+        len++;
+    return len;
+}
+#endif
+
+/*
+** probe lengths of the keys in the hash part of `t' (including nodes not
+** moved yet): their count, their sum and the longest one
+*/
+void luaH_hashstats(const Table *t, int *nkeys, int *probes, int *longest) {
+    for (int i = 0; i < sizenode(t); i++) {
+        const Node *n = gnode(t, i);
+        if (!gval(n)->isnil()) {
+            int len = probelength(t, n);
+            (*nkeys)++;
+            *probes += len;
+            if (len > *longest)
+                *longest = len;
+        }
+    }
+    if (t->old)
+        luaH_hashstats(t->old, nkeys, probes, longest);
+}
+
 /*
 ** returns the index for `key' if `key' is an appropriate key to live in
 ** the array part of the table, -1 otherwise.
 */
 static int arrayindex(const TValue *key) {
+#if LUA_INTSUBTYPE
+    if (ttisint(key)) {
+        l_int64 i = ivalue(key);
+        return (0 < i && i <= MAX_INT) ? cast_int(i) : -1;
+    }
+#endif
     if (key->isnumber()) {
         lua_Number n = nvalue(key);
         int k;
@@ -101,55 +366,125 @@ static int arrayindex(const TValue *key) {
     return -1; /* `key' did not match some condition */
 }
 
+/*
+** element `i' of the array part; a packed one is returned in the scratch
+** value, which the next read overwrites
+*/
+static inline const TValue *arrayget(Table *t, int i) {
+#if LUA_PACKEDARRAY
+    if (ispacked(t)) {
+        const Value *v = packedarray(t) + i;
+        TValue *s = t->array;
+        if (packednil(v))
+            setnilvalue(s);
+        else
+            setnvalue(s, v->n);
+        return s;
+    }
+#endif
+    return &t->array[i];
+}
+
+static inline bool arrayisnil(const Table *t, unsigned int i) {
+#if LUA_PACKEDARRAY
+    if (ispacked(t))
+        return packednil(packedarray(t) + i);
+#endif
+    return t->array[i].isnil();
+}
+
 /*
 ** returns the index of a `key' for table traversals. First goes all
 ** elements in the array part, then elements in the hash part. The
 ** beginning of a traversal is signalled by -1.
 */
-static int findindex(lua_State *L, Table *t, StkId key) {
+static int findindex(lua_State *L, Table *t, StkId k) {
+    const TValue *key = k;
     if (key->isnil())
         return -1; /* first iteration */
+#if LUA_INTSUBTYPE
+    TValue aux;
+    key = normkey(key, &aux);
+#endif
     int i = arrayindex(key);
     if (0 < i && i <= t->sizearray) /* is `key' inside array part? */
         return i - 1;               /* yes; that's the index (corrected to C) */
     else {
-        Node *n = mainposition(t, key);
-        do { /* check whether `key' is somewhere in the chain */
-            /* key may be dead already, but it is ok to use it in `next' */
-            if (luaO_rawequalObj(key2tval(n), key) ||
-                (ttype(gkey(n)) == LUA_TDEADKEY && iscollectable(key) &&
-                 gcvalue(gkey(n)) == gcvalue(key))) {
+        /* most often, the key is the one `next' returned last */
+        i = t->nexthint;
+        Node *last = nullptr;
+        if (i < sizenode(t))
+            last = gnode(t, i);
+        else if (t->old && i - sizenode(t) < sizenode(t->old))
+            last = gnode(t->old, i - sizenode(t));
+        if (last != nullptr && equalkey(last, key))
+            return i + t->sizearray;
+        /* a live key wins over a dead one that held the same object */
+        for (int dead = 0; dead <= iscollectable(key); dead++) {
+            Node *n = findnode(t, key, dead);
+            if (n != nullptr) {
                 i = cast_int(n - gnode(t, 0)); /* key index in hash table */
                 /* hash elements are numbered after array ones */
                 return i + t->sizearray;
-            } else
-                n = gnext(n);
-        } while (n);
-        luaG_runerror(L, "invalid key to " LUA_QL("next")); /* key not found */
+            }
+            if (t->old && (n = findnode(t->old, key, dead)) != nullptr) {
+                i = cast_int(n - gnode(t->old, 0)); /* not moved yet */
+                return i + t->sizearray + sizenode(t);
+            }
+        }
+        luaG_runerror(L, "invalid key to " LUA_QL("next")); /* not found */
         return 0; /* to avoid warnings */
     }
 }
 
+/*
+** pushes the first entry of hash part `h' from node `i' on, and returns
+** its index (-1 if there is none)
+*/
+static int nextnode(lua_State *L, Table *h, int i, StkId key) {
+    for (; i < sizenode(h); i++) {
+        if (!(gval(gnode(h, i)))->isnil()) { /* a non-nil value? */
+            getnodekey(L, key, gnode(h, i));
+            setobj2s(L, key + 1, gval(gnode(h, i)));
+            return i;
+        }
+    }
+    return -1;
+}
+
 int luaH_next(lua_State *L, Table *t, StkId key) {
     int i = findindex(L, t, key);       /* find original element */
-    for (i++; i < t->sizearray; i++) {  /* try first array part */
-        if (!(&t->array[i])->isnil()) { /* a non-nil value? */
-            setnvalue(key, cast_num(i + 1));
-            setobj2s(L, key + 1, &t->array[i]);
+    for (i++; i < t->sizearray; i++) {    /* try first array part */
+        const TValue *v = arrayget(t, i);
+        if (!v->isnil()) { /* a non-nil value? */
+            setivalue(key, i + 1);
+            setobj2s(L, key + 1, v);
             return 1;
         }
     }
-    for (i -= t->sizearray; i < sizenode(t); i++) { /* then hash part */
-        if (!(gval(gnode(t, i)))->isnil()) {        /* a non-nil value? */
-            setobj2s(L, key, key2tval(gnode(t, i)));
-            setobj2s(L, key + 1, gval(gnode(t, i)));
-            return 1;
-        }
+    i -= t->sizearray;
+    int n = nextnode(L, t, i, key); /* then hash part */
+    if (n < 0 && t->old) {          /* then nodes not moved yet */
+        n = nextnode(L, t->old, (i > sizenode(t)) ? i - sizenode(t) : 0, key);
+        if (n >= 0)
+            n += sizenode(t);
     }
-    return 0; /* no more elements */
+    if (n < 0)
+        return 0; /* no more elements */
+    t->nexthint = n;
+    return 1;
 }
 
 /* Rehash */
+static lu_byte sitelog(int n) {
+    if (n == 0)
+        return 0;
+    else if (n >= twoto(MAXSITEBITS))
+        return MAXSITEBITS + 1;
+    else
+        return cast_byte(ceillog2(n) + 1);
+}
+
 static int computesizes(int nums[], int *narray) {
     int a = 0;  /* number of elements smaller than 2^i */
     int na = 0; /* number of elements to go to array part */
@@ -179,7 +514,7 @@ static int countint(const TValue *key, int *nums) {
         return 0;
 }
 
-static int numusearray(const Table *t, int *nums) {
+static int numusearray(Table *t, int *nums) {
     int lg;
     int ttlg;     /* 2^lg */
     int ause = 0; /* summation of `nums' */
@@ -195,7 +530,7 @@ static int numusearray(const Table *t, int *nums) {
         }
         /* count elements in range (2^(lg-1), 2^lg] */
         for (; i <= lim; i++) {
-            if (!(&t->array[i - 1])->isnil())
+            if (!arrayget(t, i - 1)->isnil())
                 lc++;
         }
         nums[lg] += lc;
@@ -211,47 +546,185 @@ static int numusehash(const Table *t, int *nums, int *pnasize) {
     while (i--) {
         Node *n = &t->node[i];
         if (!gval(n)->isnil()) {
-            ause += countint(key2tval(n), nums);
+            TValue k;
+            getnodekey(L, &k, n);
+            ause += countint(&k, nums);
             totaluse++;
         }
     }
     *pnasize += ause;
+    if (t->old) /* count nodes not moved yet */
+        totaluse += numusehash(t->old, nums, pnasize);
     return totaluse;
 }
 
+static void reallocarray(lua_State *L, Table *t, int oldsize, int size) {
+#if LUA_PACKEDARRAY
+    if (ispacked(t)) {
+        t->array = cast(TValue *, luaM_realloc_(L, t->array,
+                                                packedbytes(oldsize),
+                                                packedbytes(size)));
+        return;
+    }
+#endif
+    luaM_reallocvector<TValue>(L, &t->array, oldsize, size);
+}
+
 static void setarrayvector(lua_State *L, Table *t, int size) {
-    luaM_reallocvector<TValue>(L, &t->array, t->sizearray, size);
+    reallocarray(L, t, t->sizearray, size);
+#if LUA_PACKEDARRAY
+    if (ispacked(t)) {
+        for (int i = t->sizearray; i < size; i++)
+            packedarray(t)[i].i = PACKEDNIL;
+        t->sizearray = size;
+        return;
+    }
+#endif
     for (int i = t->sizearray; i < size; i++)
         setnilvalue(&t->array[i]);
     t->sizearray = size;
 }
 
+#if LUA_PACKEDARRAY
+/*
+** turns a packed array part into TValues, before a value that is not a
+** number goes into it
+*/
+static void unpack(lua_State *L, Table *t) {
+    int size = t->sizearray;
+    TValue *array = luaM_newvector<TValue>(L, size);
+    for (int i = 0; i < size; i++)
+        setobj(L, &array[i], arrayget(t, i));
+    luaM_freemem(L, t->array, packedbytes(size));
+    t->array = array;
+    t->packed = 0;
+}
+#endif
+
+#if LUA_SWISSTABLE
+/*
+** makes all nodes of the hash part of `t' free
+*/
+static void initnodes(Table *t) {
+    int size = sizenode(t);
+    for (int i = 0; i < size; i++) {
+        setnilkey(gnode(t, i));
+        setnilvalue(gval(gnode(t, i)));
+    }
+    memset(gctrl(t), CTRL_EMPTY, size);
+    memset(gctrl(t) + size, CTRL_PAD, ctrlsize(t->lsizenode) - size);
+    t->growthleft = (size > GROUPSIZE) ? size / 8 * 7 : size;
+}
+
 static void setnodevector(lua_State *L, Table *t, int size) {
-    int lsize;
     if (size == 0) {                       /* no elements to hash part? */
         t->node = cast(Node *, dummynode); /* use common `dummynode' */
-        lsize = 0;
+        t->growthleft = 0;
+        t->lsizenode = 0;
     } else {
-        lsize = ceillog2(size);
+        int lsize = ceillog2(size);
+        /* beyond one group, keep an eighth of the nodes free */
+        if (twoto(lsize) > GROUPSIZE && size > twoto(lsize) / 8 * 7)
+            lsize++;
         if (lsize > MAXBITS)
             luaG_runerror(L, "table overflow");
-        size = twoto(lsize);
-        t->node = luaM_newvector<Node>(L, size);
-        for (int i = 0; i < size; i++) {
-            Node *n = gnode(t, i);
-            gnext(n) = nullptr;
-            setnilvalue(gkey(n));
-            setnilvalue(gval(n));
-        }
+        t->node = cast(Node *, luaM_malloc(L, hashbytes(lsize)));
+        t->lsizenode = cast_byte(lsize);
+        initnodes(t);
+    }
+}
+#else
+/*
+** makes all nodes of the hash part of `t' free
+*/
+static void initnodes(Table *t) {
+    int size = sizenode(t);
+    for (int i = 0; i < size; i++) {
+        Node *n = gnode(t, i);
+        gnext(n) = 0;
+        setnilkey(n);
+        setnilvalue(gval(n));
     }
-    t->lsizenode = cast_byte(lsize);
     t->lastfree = gnode(t, size); /* all positions are free */
 }
 
+static void setnodevector(lua_State *L, Table *t, int size) {
+    if (size == 0) {                       /* no elements to hash part? */
+        t->node = cast(Node *, dummynode); /* use common `dummynode' */
+        t->lsizenode = 0;
+        t->lastfree = t->node; /* no free positions */
+    } else {
+        int lsize = ceillog2(size);
+        if (lsize > MAXBITS)
+            luaG_runerror(L, "table overflow");
+        t->node = luaM_newvector<Node>(L, twoto(lsize));
+        t->lsizenode = cast_byte(lsize);
+        initnodes(t);
+    }
+}
+#endif
+
+static void freeold(lua_State *L, OldHash *o) {
+    if (o->node != dummynode)
+        luaM_freemem(L, o->node, hashbytes(o->lsizenode));
+    luaM_free(L, o);
+}
+
+static void reinsert(lua_State *L, Table *t, Node *nold, int size) {
+    for (int i = size - 1; i >= 0; i--) {
+        Node *old = nold + i;
+        if (!gval(old)->isnil()) {
+            TValue k;
+            getnodekey(L, &k, old);
+            luaH_setobj(L, t, &k, gval(old));
+        }
+    }
+}
+
+/*
+** gives `t' a new hash part, keeping the current one aside until its
+** nodes are moved (see `migrate')
+*/
+static void growhash(lua_State *L, Table *t, int nasize, int nhsize) {
+    if (nasize > t->sizearray) /* array part must grow? */
+        setarrayvector(L, t, nasize);
+    OldHash *o = luaM_new<OldHash>(L);
+    o->array = nullptr;
+    o->sizearray = 0;
+#if LUA_PACKEDARRAY
+    o->packed = 0;
+#endif
+    o->old = nullptr;
+    o->migrated = 0;
+    o->lsizenode = 0;
+    o->node = cast(Node *, dummynode); /* until the new part exists */
+    Node *nold = t->node;
+    int oldhsize = t->lsizenode;
+    t->old = o;
+    setnodevector(L, t, nhsize);
+    o->node = nold;
+    o->lsizenode = cast_byte(oldhsize);
+}
+
 static void resize(lua_State *L, Table *t, int nasize, int nhsize) {
     int oldasize = t->sizearray;
     int oldhsize = t->lsizenode;
-    Node *nold = t->node;  /* save old hash ... */
+    Node *nold = t->node; /* save old hash ... */
+    OldHash *o = t->old;  /* ... and the one being moved, if any */
+    /*
+    ** A growing array part needs no re-check of the hash keys here: the
+    ** hash part holds at most twoto(oldhsize) keys, and `rehash' asks for
+    ** that many plus the new key minus those going to the array part. So
+    ** when `nhsize > twoto(oldhsize)' no key in the hash part (nor the new
+    ** one) falls in the new array range, where `luaH_getnum' and `arrayget'
+    ** would no longer look for it in the hash or old parts.
+    */
+    if (o == nullptr && nasize >= oldasize && nhsize > twoto(oldhsize) &&
+        twoto(oldhsize) >= LUAI_INCRHASH) {
+        growhash(L, t, nasize, nhsize);
+        return;
+    }
+    t->old = nullptr;
     if (nasize > oldasize) /* array part must grow? */
         setarrayvector(L, t, nasize);
     /* create new hash part with appropriate size */
@@ -260,20 +733,22 @@ static void resize(lua_State *L, Table *t, int nasize, int nhsize) {
         t->sizearray = nasize;
         /* re-insert elements from vanishing slice */
         for (int i = nasize; i < oldasize; i++) {
-            if (!(&t->array[i])->isnil())
-                setobjt2t(L, luaH_setnum(L, t, i + 1), &t->array[i]);
+            TValue v;
+            setobj(L, &v, arrayget(t, i));
+            if (!v.isnil())
+                setobjt2t(L, luaH_setnum(L, t, i + 1), &v);
         }
         /* shrink array */
-        luaM_reallocvector<TValue>(L, &t->array, oldasize, nasize);
+        reallocarray(L, t, oldasize, nasize);
     }
     /* re-insert elements from hash part */
-    for (int i = twoto(oldhsize) - 1; i >= 0; i--) {
-        Node *old = nold + i;
-        if (!gval(old)->isnil())
-            setobjt2t(L, luaH_set(L, t, key2tval(old)), gval(old));
+    reinsert(L, t, nold, twoto(oldhsize));
+    if (o) {
+        reinsert(L, t, o->node, sizenode(o));
+        freeold(L, o);
     }
     if (nold != dummynode)
-        luaM_freearray<Node>(L, nold, twoto(oldhsize)); /* free old array */
+        luaM_freemem(L, nold, hashbytes(oldhsize)); /* free old array */
 }
 
 void luaH_resizearray(lua_State *L, Table *t, int nasize) {
@@ -298,6 +773,15 @@ static void rehash(lua_State *L, Table *t, const TValue *ek) {
     na = computesizes(nums, &nasize);
     /* resize the table to new computed sizes */
     resize(L, t, nasize, totaluse - na);
+    if (t->site) { /* tell its constructor how large it has become */
+        TableSite *ts = &G(L)->tabsites[t->site - 1];
+        lu_byte la = sitelog(nasize);
+        lu_byte lh = sitelog(totaluse - na);
+        if (la > ts->lasize)
+            ts->lasize = la;
+        if (lh > ts->lhsize)
+            ts->lhsize = lh;
+    }
 }
 
 Table *luaH_new(lua_State *L, int narray, int nhash) {
@@ -305,26 +789,142 @@ Table *luaH_new(lua_State *L, int narray, int nhash) {
     luaC_link(L, obj2gco(t), LUA_TTABLE);
     t->metatable = nullptr;
     t->flags = cast_byte(~0);
+    t->cached = 0;
+    t->site = 0;
+#if LUA_PACKEDARRAY
+    t->packed = 1; /* until it gets something else than numbers */
+#endif
     /* temporary values (kept only if some malloc fails) */
     t->array = nullptr;
     t->sizearray = 0;
+    t->lenhint = 0;
+    t->nexthint = 0;
     t->lsizenode = 0;
     t->node = cast(Node *, dummynode);
+    t->old = nullptr;
     setarrayvector(L, t, narray);
     setnodevector(L, t, nhash);
     return t;
 }
 
+/*
+** a copy of `t', without its metatable. The vectors are copied as they
+** are (chains are relative), unless part of the hash is still being moved.
+*/
+Table *luaH_clone(lua_State *L, Table *t) {
+    Table *c = luaH_new(L, 0, 0);
+    c->flags = t->flags;
+    if (t->sizearray > 0) {
+#if LUA_PACKEDARRAY
+        c->packed = t->packed;
+#endif
+        c->array = cast(TValue *, luaM_malloc(L, arraybytes(t)));
+        memcpy(c->array, t->array, arraybytes(t));
+        c->sizearray = t->sizearray;
+        c->lenhint = t->lenhint;
+    }
+    if (t->old) {
+        setnodevector(L, c, sizenode(t));
+        reinsert(L, c, t->node, sizenode(t));
+        reinsert(L, c, t->old->node, sizenode(t->old));
+    } else if (t->node != dummynode) {
+        Node *node = cast(Node *, luaM_malloc(L, hashbytes(t->lsizenode)));
+        memcpy(node, t->node, hashbytes(t->lsizenode));
+        c->node = node;
+        c->lsizenode = t->lsizenode;
+#if LUA_SWISSTABLE
+        c->growthleft = t->growthleft;
+#else
+        c->lastfree = node + (t->lastfree - t->node);
+#endif
+        c->nexthint = t->nexthint;
+    }
+    return c;
+}
+
+/*
+** removes all entries of `t', keeping its array and hash parts for reuse
+*/
+void luaH_clear(lua_State *L, Table *t) {
+    if (t->old) { /* a hash part still being moved goes away */
+        freeold(L, t->old);
+        t->old = nullptr;
+    }
+    for (int i = 0; i < t->sizearray; i++) {
+        if (ispacked(t))
+            setpackednil(packedarray(t) + i);
+        else
+            setnilvalue(&t->array[i]);
+    }
+    if (t->node != dummynode)
+        initnodes(t);
+    t->lenhint = 0;
+    t->nexthint = 0;
+    luaT_tablewrite(G(L), t);
+}
+
+/*
+** a table for the constructor at `pc', with at least the sizes that the
+** previous tables of that constructor grew to
+*/
+Table *luaH_newat(lua_State *L, int narray, int nhash,
+                  const Instruction *pc) {
+    int s = lmod(IntPoint(pc) / sizeof(Instruction), NUMSITES);
+    TableSite *ts = &G(L)->tabsites[s];
+    if (ts->pc != pc) { /* entry belongs to another constructor? */
+        ts->pc = pc;    /* take it over */
+        ts->lasize = ts->lhsize = 0;
+    }
+    if (ts->lasize > 0 && twoto(ts->lasize - 1) > narray)
+        narray = twoto(ts->lasize - 1);
+    if (ts->lhsize > 0 && twoto(ts->lhsize - 1) > nhash)
+        nhash = twoto(ts->lhsize - 1);
+    Table *t = luaH_new(L, narray, nhash);
+    t->site = cast(unsigned short, s + 1);
+    return t;
+}
+
 void luaH_free(lua_State *L, Table *t) {
     if (t->node != dummynode)
-        luaM_freearray<Node>(L, t->node, sizenode(t));
-    luaM_freearray<TValue>(L, t->array, t->sizearray);
+        luaM_freemem(L, t->node, hashbytes(t->lsizenode));
+    if (t->old)
+        freeold(L, t->old);
+    luaM_freemem(L, t->array, arraybytes(t));
     luaM_free(L, t);
 }
 
+#if LUA_SWISSTABLE
+/*
+** inserts a new key into a hash table, in the first free node of its
+** probe sequence; returns nullptr if the table had to grow instead
+*/
+static TValue *insertkey(lua_State *L, Table *t, const TValue *key) {
+    if (t->growthleft == 0) { /* no room left? */
+        rehash(L, t, key);    /* grow table */
+        return nullptr;
+    }
+    unsigned int h = hashkey(key);
+    int mask = numgroups(t) - 1;
+    int g = firstgroup(t, h);
+    unsigned int m;
+    for (int step = 1;; step++) {
+        m = matchbyte(gctrl(t) + g * GROUPSIZE, CTRL_EMPTY);
+        if (m != 0)
+            break;
+        g = (g + step) & mask;
+    }
+    int i = g * GROUPSIZE + lowbit(m);
+    gctrl(t)[i] = ctrlbyte(h);
+    t->growthleft--;
+    Node *n = gnode(t, i);
+    setnodekey(L, n, key);
+    luaC_barriert(L, t, key);
+    return gval(n);
+}
+#else
 static Node *getfreepos(Table *t) {
     while (t->lastfree-- > t->node) {
-        if ((gkey(t->lastfree))->isnil())
+        if (keyisnil(t->lastfree))
             return t->lastfree;
     }
     return nullptr; /* could not find a free place */
@@ -335,39 +935,99 @@ static Node *getfreepos(Table *t) {
 ** position is free. If not, check whether colliding node is in its main
 ** position or not: if it is not, move colliding node to an empty place and
 ** put new key in its main position; otherwise (colliding node is in its main
-** position), new key goes to an empty position.
+** position), new key goes to an empty position. Returns nullptr if the
+** table had to grow instead.
 */
-static TValue *newkey(lua_State *L, Table *t, const TValue *key) {
+static TValue *insertkey(lua_State *L, Table *t, const TValue *key) {
     Node *mp = mainposition(t, key);
     if (!gval(mp)->isnil() || mp == dummynode) {
         Node *othern;
         Node *n = getfreepos(t);        /* get a free place */
-        if (n == nullptr) {             /* cannot find a free place? */
-            rehash(L, t, key);          /* grow table */
-            return luaH_set(L, t, key); /* re-insert key into grown table */
+        if (n == nullptr) {    /* cannot find a free place? */
+            rehash(L, t, key); /* grow table */
+            return nullptr;
         }
-        othern = mainposition(t, key2tval(mp));
+        TValue k;
+        getnodekey(L, &k, mp);
+        othern = mainposition(t, &k);
         if (othern != mp) { /* is colliding node out of its main position? */
             /* yes; move colliding node into free position */
-            while (gnext(othern) != mp)
-                othern = gnext(othern); /* find previous */
-            gnext(othern) = n; /* redo the chain with `n' in place of `mp' */
-            *n = *mp; /* copy colliding node into free pos. (mp->next also goes)
-                       */
-            gnext(mp) = nullptr; /* now `mp' is free */
+            while (othern + gnext(othern) != mp)
+                othern += gnext(othern); /* find previous */
+            /* redo the chain with `n' in place of `mp' */
+            gnext(othern) = cast_int(n - othern);
+            *n = *mp; /* copy colliding node into free pos. */
+            if (gnext(mp) != 0) {
+                gnext(n) += cast_int(mp - n); /* correct `next' */
+                gnext(mp) = 0;                /* now `mp' is free */
+            }
             setnilvalue(gval(mp));
         } else { /* colliding node is in its own main position */
             /* new node will go into free position */
-            gnext(n) = gnext(mp); /* chain new position */
-            gnext(mp) = n;
+            if (gnext(mp) != 0) /* chain new position */
+                gnext(n) = cast_int((mp + gnext(mp)) - n);
+            gnext(mp) = cast_int(n - mp);
             mp = n;
         }
     }
-    gkey(mp)->value = key->value;
-    gkey(mp)->tt = key->tt;
+    setnodekey(L, mp, key);
     luaC_barriert(L, t, key);
     return gval(mp);
 }
+#endif
+
+static TValue *newkey(lua_State *L, Table *t, const TValue *key) {
+    TValue *slot = insertkey(L, t, key);
+    if (slot == nullptr)            /* table has grown? */
+        return luaH_set(L, t, key); /* re-insert key into grown table */
+    return slot;
+}
+
+/*
+** moves the next LUAI_HASHSTEP nodes of the old hash part to the new one;
+** a moved node keeps its place in any chain, but with a nil key
+*/
+static void migrate(lua_State *L, Table *t) {
+    for (int step = 0; step < LUAI_HASHSTEP; step++) {
+        OldHash *o = t->old;
+        if (o == nullptr) /* finished by a rehash? */
+            return;
+        if (o->migrated == sizenode(o)) { /* all nodes moved? */
+            t->old = nullptr;
+            freeold(L, o);
+            return;
+        }
+        Node *n = gnode(o, o->migrated++);
+        if (gval(n)->isnil())
+            setnilkey(n); /* nothing to move, but it cannot be found again */
+        else {
+            TValue k, v;
+            getnodekey(L, &k, n);
+            setobj(L, &v, gval(n));
+            setnilkey(n);
+            setnilvalue(gval(n));
+#if LUA_PACKEDARRAY
+            Value *pv = luaH_packedslot(t, &k);
+            if (pv != nullptr) {
+                if (v.isnumber()) {
+                    setpackednum(pv, nvalue(&v));
+                    continue;
+                }
+                unpack(L, t);
+            }
+#endif
+            const TValue *p = luaH_get(t, &k); /* array slot? */
+            TValue *slot = (p != luaO_nilobject) ? cast(TValue *, p)
+                                                 : newkey(L, t, &k);
+            setobjt2t(L, slot, &v);
+        }
+    }
+}
+
+/*
+** a key missing from the hash part may still be in the old one
+*/
+#define missing(t, get) ((t)->old ? (get) : luaO_nilobject)
 
 /*
 ** search function for integers
@@ -375,44 +1035,110 @@ static TValue *newkey(lua_State *L, Table *t, const TValue *key) {
 const TValue *luaH_getnum(Table *t, int key) {
     /* (1 <= key && key <= t->sizearray) */
     if (cast(unsigned int, key - 1) < cast(unsigned int, t->sizearray))
-        return &t->array[key - 1];
+        return arrayget(t, key - 1);
+#if LUA_SWISSTABLE
     else {
+#if LUA_INTSUBTYPE
+        Node *n = probe(t, mixhash(intbits(key)), [key](const Node *p) {
+            return keyisint(p) && keyival(p) == key;
+        });
+#else
+        lua_Number nk = cast_num(key);
+        Node *n = probe(t, mixhash(numbits(nk)), [nk](const Node *p) {
+            return keyisnumber(p) && luai_numeq(keynval(p), nk);
+        });
+#endif
+        return n ? gval(n) : missing(t, luaH_getnum(t->old, key));
+    }
+#else
+    else {
+#if LUA_INTSUBTYPE
+        Node *n = hashint(t, key);
+        for (;;) { /* check whether `key' is somewhere in the chain */
+            if (keyisint(n) && keyival(n) == key)
+                return gval(n); /* that's it */
+#else
         lua_Number nk = cast_num(key);
         Node *n = hashnum(t, nk);
-        do { /* check whether `key' is somewhere in the chain */
-            if ((gkey(n))->isnumber() && luai_numeq(nvalue(gkey(n)), nk))
+        for (;;) { /* check whether `key' is somewhere in the chain */
+            if (keyisnumber(n) && luai_numeq(keynval(n), nk))
                 return gval(n); /* that's it */
-            else
-                n = gnext(n);
-        } while (n);
-        return luaO_nilobject;
+#endif
+            if (gnext(n) == 0)
+                return missing(t, luaH_getnum(t->old, key));
+            n += gnext(n);
+        }
     }
+#endif
 }
 
+#if LUA_SWISSTABLE
+#define findstr(t, key)                                                        \
+    probe(t, mixhash(luaS_hashof(key)), [key](const Node *p) {                 \
+        return keyisstring(p) && luaS_eqstr(key, keystrval(p));               \
+    })
+
+const TValue *luaH_getstr(Table *t, TString *key) {
+    Node *n = findstr(t, key);
+    return n ? gval(n) : missing(t, luaH_getstr(t->old, key));
+}
+
+int luaH_strslot(Table *t, TString *key) {
+    Node *n = findstr(t, key);
+    return n ? cast_int(n - t->node) : -1;
+}
+#else
 /*
 ** search function for strings
 */
 const TValue *luaH_getstr(Table *t, TString *key) {
     Node *n = hashstr(t, key);
-    do { /* check whether `key' is somewhere in the chain */
-        if ((gkey(n)->isstring()) && rawtsvalue(gkey(n)) == key)
+    for (;;) { /* check whether `key' is somewhere in the chain */
+        if (keyisstring(n) && luaS_eqstr(key, keystrval(n)))
             return gval(n); /* that's it */
-        else
-            n = gnext(n);
-    } while (n);
-    return luaO_nilobject;
+        if (gnext(n) == 0)
+            return missing(t, luaH_getstr(t->old, key));
+        n += gnext(n);
+    }
 }
 
+/*
+** index of the node holding string key `key', or -1 if absent
+*/
+int luaH_strslot(Table *t, TString *key) {
+    Node *n = hashstr(t, key);
+    for (;;) {
+        if (keyisstring(n) && luaS_eqstr(key, keystrval(n)))
+            return cast_int(n - t->node);
+        if (gnext(n) == 0)
+            return -1;
+        n += gnext(n);
+    }
+}
+#endif
+
 /*
 ** main search function
 */
 const TValue *luaH_get(Table *t, const TValue *key) {
+#if LUA_INTSUBTYPE
+    TValue aux;
+#endif
     switch (ttype(key)) {
     case LUA_TNIL:
         return luaO_nilobject;
     case LUA_TSTRING:
         return luaH_getstr(t, rawtsvalue(key));
     case LUA_TNUMBER: {
+#if LUA_INTSUBTYPE
+        key = normkey(key, &aux);
+        if (ttisint(key)) {
+            l_int64 i = ivalue(key);
+            if (cast(int, i) == i) /* fits in an int? */
+                return luaH_getnum(t, cast_int(i));
+            goto hashpart; /* avoid the float test below */
+        }
+#endif
         int k;
         lua_Number n = nvalue(key);
         lua_number2int(k, n);
@@ -420,22 +1146,43 @@ const TValue *luaH_get(Table *t, const TValue *key) {
             return luaH_getnum(t, k);             /* use specialized version */
                                                   /* else go through */
     }
-    default: {
+    default:
+#if LUA_INTSUBTYPE
+    hashpart:
+#endif
+    {
+#if LUA_SWISSTABLE
+        Node *n = probe(t, hashkey(key), [key](const Node *p) {
+            return equalkey(p, key);
+        });
+        return n ? gval(n) : missing(t, luaH_get(t->old, key));
+#else
         Node *n = mainposition(t, key);
-        do { /* check whether `key' is somewhere in the chain */
-            if (luaO_rawequalObj(key2tval(n), key))
+        for (;;) { /* check whether `key' is somewhere in the chain */
+            if (equalkey(n, key))
                 return gval(n); /* that's it */
-            else
-                n = gnext(n);
-        } while (n);
-        return luaO_nilobject;
+            if (gnext(n) == 0)
+                return missing(t, luaH_get(t->old, key));
+            n += gnext(n);
+        }
+#endif
     }
     }
 }
 
 TValue *luaH_set(lua_State *L, Table *t, const TValue *key) {
+#if LUA_INTSUBTYPE
+    TValue aux;
+    key = normkey(key, &aux); /* the key to store */
+#endif
+#if LUA_PACKEDARRAY
+    if (luaH_packedslot(t, key) != nullptr) /* slot may get any value? */
+        unpack(L, t);
+#endif
     const TValue *p = luaH_get(t, key);
     t->flags = 0;
+    if (key->isstring()) /* only string keys are cached */
+        luaT_tablewrite(G(L), t);
     if (p != luaO_nilobject)
         return cast(TValue *, p);
     else {
@@ -443,32 +1190,79 @@ TValue *luaH_set(lua_State *L, Table *t, const TValue *key) {
             luaG_runerror(L, "table index is nil");
         else if (key->isnumber() && luai_numisnan(nvalue(key)))
             luaG_runerror(L, "table index is NaN");
+        if (t->old)
+            migrate(L, t);
         return newkey(L, t, key);
     }
 }
 
 TValue *luaH_setnum(lua_State *L, Table *t, int key) {
+#if LUA_PACKEDARRAY
+    if (ispacked(t) &&
+        cast(unsigned int, key - 1) < cast(unsigned int, t->sizearray))
+        unpack(L, t);
+#endif
     const TValue *p = luaH_getnum(t, key);
     if (p != luaO_nilobject)
         return cast(TValue *, p);
     else {
         TValue k;
-        setnvalue(&k, cast_num(key));
+        setivalue(&k, key);
+        if (t->old)
+            migrate(L, t);
         return newkey(L, t, &k);
     }
 }
 
 TValue *luaH_setstr(lua_State *L, Table *t, TString *key) {
     const TValue *p = luaH_getstr(t, key);
+    luaT_tablewrite(G(L), t);
     if (p != luaO_nilobject)
         return cast(TValue *, p);
     else {
         TValue k;
         setsvalue(L, &k, key);
+        if (t->old)
+            migrate(L, t);
         return newkey(L, t, &k);
     }
 }
 
+/*
+** t[key] = val, without metamethods. A number for an integer key keeps a
+** packed array part packed, even when the table has to grow for it.
+*/
+void luaH_setobj(lua_State *L, Table *t, const TValue *key,
+                 const TValue *val) {
+#if LUA_PACKEDARRAY
+    if (val->isnumber() && arrayindex(key) > 0) {
+        int moved = 0;
+        while (ispacked(t)) {
+            Value *pv = luaH_packedslot(t, key);
+            if (pv != nullptr) {
+                setpackednum(pv, nvalue(val));
+                return;
+            }
+            const TValue *p = luaH_get(t, key);
+            if (p == luaO_nilobject && t->old && !moved) {
+                migrate(L, t); /* may grow the array part */
+                moved = 1;
+                continue;
+            }
+            TValue *slot = (p != luaO_nilobject) ? cast(TValue *, p)
+                                                 : insertkey(L, t, key);
+            if (slot != nullptr) {
+                setobj2t(L, slot, val);
+                return;
+            }
+            /* else the table has grown: the key may be in the array now */
+        }
+    }
+#endif
+    setobj2t(L, luaH_set(L, t, key), val);
+    luaC_barriert(L, t, val);
+}
+
 static int unbound_search(Table *t, unsigned int j) {
     unsigned int i = j; /* i is zero or a present index */
     j++;
@@ -495,23 +1289,39 @@ static int unbound_search(Table *t, unsigned int j) {
     return i;
 }
 
+/*
+** whether `i' is a boundary inside the array part (whose last slot is
+** empty)
+*/
+#define isborder(t, i, j)                                                      \
+    ((i) < (j) && ((i) == 0 || !arrayisnil(t, (i)-1)) && arrayisnil(t, i))
+
 /*
 ** Try to find a boundary in table `t'. A `boundary' is an integer index
 ** such that t[i] is non-nil and t[i+1] is nil (and 0 if t[1] is nil).
+** Appends and removals at the end move the boundary by one, so the one
+** found last time and its neighbours are tried before a search.
 */
 int luaH_getn(Table *t) {
     unsigned int j = t->sizearray;
-    if (j > 0 && (&t->array[j - 1])->isnil()) {
+    if (j > 0 && arrayisnil(t, j - 1)) {
+        unsigned int h = t->lenhint;
+        if (isborder(t, h, j))
+            return h;
+        else if (isborder(t, h + 1, j)) /* an element was appended? */
+            return ++t->lenhint;
+        else if (h > 0 && isborder(t, h - 1, j)) /* or removed? */
+            return --t->lenhint;
         /* there is a boundary in the array part: (binary) search for it */
         unsigned int i = 0;
         while (j - i > 1) {
             unsigned int m = (i + j) / 2;
-            if ((&t->array[m - 1])->isnil())
+            if (arrayisnil(t, m - 1))
                 j = m;
             else
                 i = m;
         }
-        return i;
+        return t->lenhint = i;
     }
     /* else must find a boundary in hash part */
     else if (t->node == dummynode) /* hash part is empty? */
@@ -4,22 +4,143 @@
 #include "lobject.h"
 
 #define gnode(t, i) (&(t)->node[i])
-#define gkey(n) (&(n)->i_key)
 #define gval(n) (&(n)->i_val)
-#define gnext(n) ((n)->i_key.next)
 
-#define key2tval(n) (&(n)->i_key)
+/* keys are not TValues; they are read and written through these macros */
+#if LUA_NANBOXING
+#define keytt(n) ttype(&(n)->i_key)
+#define keyisnil(n) ((n)->i_key.isnil())
+#define keyisnumber(n) ((n)->i_key.isnumber())
+#define keynval(n) nvalue(&(n)->i_key)
+#define gckey(n) gcvalue(&(n)->i_key)
+#define setnilkey(n) setnilvalue(&(n)->i_key)
+#define setdeadkey(n) setttype(&(n)->i_key, LUA_TDEADKEY)
+#define getnodekey(L, obj, n) setobj(L, obj, &(n)->i_key)
+#define setnodekey(L, n, obj) setobj(L, &(n)->i_key, obj)
+#else
+#define keyrawtt(n) ((n)->u.key_tt)
+#if LUA_INTSUBTYPE
+#define keytt(n) (keyrawtt(n) & 0x0F)
+#define keyisint(n) (keyrawtt(n) == LUA_TNUMINT)
+#define keyival(n) ((n)->u.key_val.i)
+#else
+#define keytt(n) keyrawtt(n)
+#endif
+#define keyisnil(n) (keyrawtt(n) == LUA_TNIL)
+#define keyisnumber(n) (keyrawtt(n) == LUA_TNUMBER)
+#define keynval(nd) ((nd)->u.key_val.n)
+#define gckey(n) ((n)->u.key_val.gc)
+#define setnilkey(n) (keyrawtt(n) = LUA_TNIL)
+#define setdeadkey(n) (keyrawtt(n) = LUA_TDEADKEY)
+
+#define getnodekey(L, obj, n)                                                  \
+    {                                                                          \
+        TValue *io_ = (obj);                                                   \
+        const Node *n_ = (n);                                                  \
+        io_->value = n_->u.key_val;                                            \
+        io_->tt = n_->u.key_tt;                                                \
+    }
+
+#define setnodekey(L, n, obj)                                                  \
+    {                                                                          \
+        Node *n_ = (n);                                                        \
+        const TValue *io_ = (obj);                                             \
+        n_->u.key_val = io_->value;                                            \
+        n_->u.key_tt = io_->tt;                                                \
+    }
+#endif
+
+#define keyisstring(n) (keytt(n) == LUA_TSTRING)
+#define keystrval(n) (&gckey(n)->ts)
+#define keyiscollectable(n) (keytt(n) >= LUA_TSTRING)
+#define keyisdead(n) (keytt(n) == LUA_TDEADKEY)
+
+#if LUA_SWISSTABLE
+/* control bytes follow the nodes; small tables pad them to a whole group */
+#define GROUPSIZE 16
+#define ctrlsize(ls) (twoto(ls) < GROUPSIZE ? GROUPSIZE : twoto(ls))
+#define gctrl(t) (cast(lu_byte *, (t)->node + sizenode(t)))
+#define hashbytes(ls) (sizeof(Node) * twoto(ls) + ctrlsize(ls))
+#else
+#if LUA_NANBOXING
+#define gnext(n) ((n)->next)
+#else
+#define gnext(n) ((n)->u.next)
+#endif
+#define hashbytes(ls) (sizeof(Node) * twoto(ls))
+#endif
+
+#if LUA_PACKEDARRAY
+/*
+** a packed array part is a scratch TValue, that reads of an element return,
+** followed by the raw numbers; a signaling NaN marks an empty slot
+*/
+#define PACKEDNIL cast(l_int64, 0x7FF4000000000000LL)
+#define PACKEDNAN cast(l_int64, 0x7FF8000000000000LL)
+#define ispacked(t) ((t)->packed)
+#define packedarray(t) cast(Value *, (t)->array + 1)
+#define packedbytes(n) ((n) > 0 ? sizeof(TValue) + sizeof(Value) * (n) : 0)
+#define arraybytes(t)                                                          \
+    (ispacked(t) ? packedbytes((t)->sizearray) : sizeof(TValue) * (t)->sizearray)
+#define packednil(v) ((v)->i == PACKEDNIL)
+#define setpackednil(v) ((v)->i = PACKEDNIL)
+
+#define setpackednum(v, x)                                                     \
+    {                                                                          \
+        Value *v_ = (v);                                                       \
+        v_->n = (x);                                                           \
+        if (v_->i == PACKEDNIL)                                                \
+            v_->i = PACKEDNAN;                                                 \
+    }
+
+/*
+** the slot of `key' in the packed array part of `t', if it has one
+*/
+static inline Value *luaH_packedslot(Table *t, const TValue *key) {
+    if (!ispacked(t) || !key->isnumber())
+        return nullptr;
+    lua_Number n = nvalue(key);
+    int k;
+    lua_number2int(k, n);
+    if (!luai_numeq(cast_num(k), n) ||
+        cast(unsigned int, k - 1) >= cast(unsigned int, t->sizearray))
+        return nullptr;
+    return packedarray(t) + (k - 1);
+}
+#else
+#define ispacked(t) 0
+#define arraybytes(t) (sizeof(TValue) * (t)->sizearray)
+#define luaH_packedslot(t, key) (cast(Value *, nullptr))
+#define packednil(v) 1
+#define setpackednil(v) ((void)0)
+#define setpackednum(v, x) ((void)0)
+#endif
 
+/*
+** the `get' functions may return an element of a packed array part in the
+** scratch value of `t' (see `arrayget'): the result is valid only until the
+** next get on `t' and must not be written through. Copy it out before
+** looking up another key of the same table.
+*/
 LUAI_FUNC const TValue *luaH_getnum(Table *t, int key);
 LUAI_FUNC TValue *luaH_setnum(lua_State *L, Table *t, int key);
 LUAI_FUNC const TValue *luaH_getstr(Table *t, TString *key);
+LUAI_FUNC int luaH_strslot(Table *t, TString *key);
 LUAI_FUNC TValue *luaH_setstr(lua_State *L, Table *t, TString *key);
 LUAI_FUNC const TValue *luaH_get(Table *t, const TValue *key);
 LUAI_FUNC TValue *luaH_set(lua_State *L, Table *t, const TValue *key);
+LUAI_FUNC void luaH_setobj(lua_State *L, Table *t, const TValue *key,
+                           const TValue *val);
 LUAI_FUNC Table *luaH_new(lua_State *L, int narray, int lnhash);
+LUAI_FUNC Table *luaH_newat(lua_State *L, int narray, int nhash,
+                            const Instruction *pc);
 LUAI_FUNC void luaH_resizearray(lua_State *L, Table *t, int nasize);
+LUAI_FUNC Table *luaH_clone(lua_State *L, Table *t);
+LUAI_FUNC void luaH_clear(lua_State *L, Table *t);
 LUAI_FUNC void luaH_free(lua_State *L, Table *t);
 LUAI_FUNC int luaH_next(lua_State *L, Table *t, StkId key);
 LUAI_FUNC int luaH_getn(Table *t);
+LUAI_FUNC void luaH_hashstats(const Table *t, int *nkeys, int *probes,
+                              int *longest);
 
 #endif
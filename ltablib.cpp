@@ -243,10 +243,41 @@ static int sort(lua_State *L) {
 
 /* }====================================================== */
 
+/*
+** a table presized for `narray' sequence elements and `nhash' other ones
+*/
+static int tnew(lua_State *L) {
+    int narray = luaL_optint(L, 1, 0);
+    int nhash = luaL_optint(L, 2, 0);
+    luaL_argcheck(L, narray >= 0, 1, "negative size");
+    luaL_argcheck(L, nhash >= 0, 2, "negative size");
+    lua_createtable(L, narray, nhash);
+    return 1;
+}
+
+/*
+** empties a table so that it can be filled again without allocating
+*/
+static int tclear(lua_State *L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_cleartable(L, 1);
+    return 0;
+}
+
+/*
+** a shallow copy of a table, without its metatable
+*/
+static int tclone(lua_State *L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_clonetable(L, 1);
+    return 1;
+}
+
 static const luaL_Reg tab_funcs[] = {
-    {"concat", tconcat}, {"foreach", foreach}, {"foreachi", foreachi},
-    {"getn", getn},      {"maxn", maxn},       {"insert", tinsert},
-    {"remove", tremove}, {"setn", setn},       {"sort", sort},
+    {"clear", tclear},    {"clone", tclone},      {"concat", tconcat},
+    {"foreach", foreach}, {"foreachi", foreachi}, {"getn", getn},
+    {"insert", tinsert},  {"maxn", maxn},         {"new", tnew},
+    {"remove", tremove},  {"setn", setn},         {"sort", sort},
     {nullptr, nullptr}};
 
 LUALIB_API int luaopen_table(lua_State *L) {
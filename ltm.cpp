@@ -25,6 +25,17 @@ void luaT_init(lua_State *L) {
         G(L)->tmname[i] = luaS_new(L, luaT_eventname[i]);
         luaS_fix(G(L)->tmname[i]); /* never collect these names */
     }
+    for (int i = 0; i < INDEXCACHESIZE; i++)
+        G(L)->idxcache[i].mt = nullptr;
+    G(L)->idxversion = 1;
+}
+
+void luaT_invalidate(global_State *g) {
+    if (++g->idxversion == 0) { /* wrapped around? */
+        for (int i = 0; i < INDEXCACHESIZE; i++)
+            g->idxcache[i].mt = nullptr;
+        g->idxversion = 1;
+    }
 }
 
 /*
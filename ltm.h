@@ -3,6 +3,8 @@
 
 #include "lobject.h"
 
+struct global_State;
+
 /*
  * WARNING: if you change the order of this enumeration,
  * grep "ORDER TM"
@@ -35,11 +37,43 @@ enum TMS {
 
 #define fasttm(l, et, e) gfasttm(G(l), et, e)
 
+/*
+** cache of `__index' chains: value that string `key' resolves to through
+** the `__index' tables reachable from metatable `mt'. Entries are valid
+** while `version' matches the global one, which is bumped by any write
+** to a table some entry depends on and by every garbage collection.
+*/
+struct IndexCache {
+    Table *mt;
+    TString *key;
+    TValue val;
+    unsigned int version;
+};
+
+#define INDEXCACHESIZE 256 /* must be a power of 2 */
+
+/* entry for `key' looked up through metatable `mt' */
+#define luaT_idxslot(g, mt, key)                                               \
+    (&(g)->idxcache[lmod(IntPoint(mt) ^ (key)->hash, INDEXCACHESIZE)])
+
+/*
+** a write to table `t' may change some cached resolution; once all entries
+** are gone none depends on `t', until a new lookup goes through it again
+*/
+#define luaT_tablewrite(g, t)                                                  \
+    {                                                                          \
+        if ((t)->cached) {                                                     \
+            (t)->cached = 0;                                                   \
+            luaT_invalidate(g);                                                \
+        }                                                                      \
+    }
+
 LUAI_DATA const char *const luaT_typenames[];
 
 LUAI_FUNC const TValue *luaT_gettm(Table *events, TMS event, TString *ename);
 LUAI_FUNC const TValue *luaT_gettmbyobj(lua_State *L, const TValue *o,
                                         TMS event);
+LUAI_FUNC void luaT_invalidate(global_State *g);
 LUAI_FUNC void luaT_init(lua_State *L);
 
 #endif
@@ -46,6 +46,8 @@
 #define LUAI_GCMUL 200   /* GC runs 'twice the speed' of memory allocation */
 
 #define LUAI_UINT32 unsigned int
+#define LUAI_UINT64 unsigned long long
+#define LUAI_INT64 long long
 #define LUAI_INT32 int
 #define LUAI_UMEM size_t
 #define LUAI_MEM ptrdiff_t
@@ -56,6 +58,18 @@
 #define LUAI_MAXVARS 200
 #define LUAI_MAXUPVALUES 60
 
+/* hash parts with at least this many nodes grow incrementally */
+#ifndef LUAI_INCRHASH
+#define LUAI_INCRHASH 4096
+#endif
+/* old nodes moved to the new hash part on each insertion meanwhile */
+#define LUAI_HASHSTEP 8
+
+/* longer strings are not interned, and are hashed only when needed */
+#ifndef LUAI_MAXSHORTLEN
+#define LUAI_MAXSHORTLEN 40
+#endif
+
 /* minimum Lua stack available to a C function */
 #define LUA_MINSTACK 20
 
@@ -65,6 +79,8 @@
 #define LUA_NUMBER_FMT "%.14g"
 #define lua_number2str(s, n) sprintf((s), LUA_NUMBER_FMT, (n))
 #define LUAI_MAXNUMBER2STR 32 /* 16 digits, sign, point, and \0 */
+#define LUA_INT64_FMT "%lld"
+#define lua_int2str(s, i) sprintf((s), LUA_INT64_FMT, (i))
 #define lua_str2number(s, p) strtod((s), (p))
 
 #if defined(LUA_CORE)
@@ -315,9 +331,17 @@ LUA_API int(lua_gc)(lua_State *L, int what, int data);
 LUA_API int(lua_error)(lua_State *L);
 
 LUA_API int(lua_next)(lua_State *L, int idx);
+LUA_API void(lua_clonetable)(lua_State *L, int idx);
+LUA_API void(lua_cleartable)(lua_State *L, int idx);
+LUA_API void(lua_hashstats)(lua_State *L, int idx, int *nkeys, int *probes,
+                            int *longest);
 
 LUA_API void(lua_concat)(lua_State *L, int n);
 
+LUA_API char *(lua_newbuffer)(lua_State *L, size_t size);
+LUA_API char *(lua_growbuffer)(lua_State *L, int idx, size_t size);
+LUA_API void(lua_closebuffer)(lua_State *L, int idx, size_t len);
+
 /*
 ** ===============================================================
 ** some useful macros
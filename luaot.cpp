@@ -0,0 +1,594 @@
+/*
+** luaot: compiles a Lua module ahead of time to a C++ translation unit.
+**
+** The output embeds the precompiled chunk and, for every function with
+** loops, a C++ function that runs its instructions with native control
+** flow: each instruction becomes a label, jumps become `goto', constant
+** operands become literals, and table, global and upvalue accesses call
+** the same helpers as the JIT (luaV_fastget and friends). Registers stay
+** on the Lua stack, so any instruction the output does not cover (calls,
+** closures, metamethods, errors) returns to the interpreter, which enters
+** the compiled code again at the next loop back edge.
+**
+** The output includes internal headers: build it with the same sources
+** and configuration as the Lua it is linked with, then call
+** luaot_preload_<name>(L) to register the module in `package.preload'.
+*/
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define luaot_c
+#define LUA_CORE
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lobject.h"
+#include "lopcodes.h"
+#include "lstate.h"
+
+#define PROGNAME "luaot"
+
+static const char *progname = PROGNAME;
+
+static void fatal(const char *message) {
+    fprintf(stderr, "%s: %s\n", progname, message);
+    exit(EXIT_FAILURE);
+}
+
+static void usage(const char *message) {
+    if (message != nullptr)
+        fprintf(stderr, "%s: %s\n", progname, message);
+    fprintf(stderr,
+            R"(usage: %s [options] module.lua
+Available options are:
+  -n name  module name for `require' (default: the file name)
+  -o file  write the output to 'file' (default: stdout)
+)",
+            progname);
+    exit(EXIT_FAILURE);
+}
+
+/*
+** {======================================================
+** Code generation
+** =======================================================
+*/
+
+struct Gen {
+    FILE *out;
+    const Proto *p; /* function being compiled */
+    size_t nbytes;  /* bytes of the chunk written so far */
+};
+
+/* a number constant as a C++ literal (0 if it has none) */
+static int numliteral(const TValue *o, char *buff) {
+    if (!o->isnumber() || !std::isfinite(nvalue(o)))
+        return 0;
+    sprintf(buff, "%.17g", nvalue(o));
+    if (strpbrk(buff, ".e") == nullptr)
+        strcat(buff, ".0");
+    return 1;
+}
+
+/* operand `x' (register or constant) as a TValue pointer */
+static const char *rk(int x, char *buff) {
+    if (ISK(x))
+        sprintf(buff, "K(%d)", INDEXK(x));
+    else
+        sprintf(buff, "R(%d)", x);
+    return buff;
+}
+
+/*
+** operand `x' as a lua_Number, guarding that a register holds a number;
+** returns 0 for a constant that is not a number (the instruction always
+** needs the interpreter)
+*/
+static int numop(Gen *G, int x, int pc, char *buff) {
+    if (ISK(x)) {
+        const TValue *o = &G->p->k[INDEXK(x)];
+        if (numliteral(o, buff))
+            return 1;
+        if (!o->isnumber())
+            return 0;
+        sprintf(buff, "nvalue(K(%d))", INDEXK(x));
+    } else {
+        fprintf(G->out, "    if (!R(%d)->isnumber()) return %d;\n", x, pc);
+        sprintf(buff, "nvalue(R(%d))", x);
+    }
+    return 1;
+}
+
+/* can operand `x' hold a number? (registers are checked at run time) */
+static int numoperand(const Proto *p, int x) {
+    return !ISK(x) || p->k[INDEXK(x)].isnumber();
+}
+
+static int jumptarget(const Proto *p, int pc) {
+    return pc + 1 + GETARG_sBx(p->code[pc]);
+}
+
+/*
+** step of the numeric loop closed by FORLOOP at `pc', when it is a
+** constant: returns 1 if it counts up, -1 if down, 0 if unknown
+*/
+static int forstep(const Proto *p, int pc, char *buff) {
+    int prep = jumptarget(p, pc) - 1;
+    int a = GETARG_A(p->code[pc]);
+    if (prep < 1 || GET_OPCODE(p->code[prep]) != OP_FORPREP)
+        return 0;
+    Instruction i = p->code[prep - 1];
+    if (GET_OPCODE(i) != OP_LOADK || GETARG_A(i) != a + 2)
+        return 0;
+    const TValue *step = &p->k[GETARG_Bx(i)];
+    if (!numliteral(step, buff))
+        return 0;
+    return luai_numlt(0, nvalue(step)) ? 1 : -1;
+}
+
+static void gotopc(Gen *G, int pc, int target, int indent) {
+    if (target <= pc) /* back edge: let the interpreter run hooks */
+        fprintf(G->out, "%*sif (hasinstrhook(L)) return %d;\n", indent, "",
+                target);
+    fprintf(G->out, "%*sgoto L%d;\n", indent, "", target);
+}
+
+/* the jump of a test at `pc' (taken when `cond') */
+static void condjump(Gen *G, int pc, const char *cond) {
+    fprintf(G->out, "    if (%s) {\n", cond);
+    gotopc(G, pc, jumptarget(G->p, pc + 1), 8);
+    fprintf(G->out, "    }\n    goto L%d;\n", pc + 2);
+}
+
+static const char *const arithop[] = {"luai_numadd", "luai_numsub",
+                                      "luai_nummul", "luai_numdiv",
+                                      "luai_nummod", "luai_numpow"};
+
+/*
+** instructions that compiled code may continue at after `pc': stores the
+** targets of its jumps in `next' and returns their number, or -1 if the
+** interpreter must execute it; `falls' tells whether it may go on at pc + 1
+*/
+static int successors(const Proto *p, int pc, int *next, int *falls) {
+    Instruction i = p->code[pc];
+    int op = luaP_baseop[GET_OPCODE(i)];
+    *falls = 1;
+    switch (op) {
+    case OP_MOVE:
+    case OP_LOADK:
+    case OP_LOADNIL:
+    case OP_GETUPVAL:
+    case OP_SETUPVAL:
+    case OP_GETGLOBAL:
+    case OP_SETGLOBAL:
+    case OP_GETTABLE:
+    case OP_SETTABLE:
+    case OP_UNM:
+    case OP_NOT:
+    case OP_LEN:
+        return 0;
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+    case OP_POW:
+        if (!numoperand(p, GETARG_B(i)) || !numoperand(p, GETARG_C(i)))
+            return -1;
+        return 0;
+    case OP_LOADBOOL:
+        if (GETARG_C(i) == 0)
+            return 0;
+        *falls = 0;
+        next[0] = pc + 2;
+        return 1;
+    case OP_JMP:
+    case OP_FORPREP:
+        *falls = 0;
+        next[0] = jumptarget(p, pc);
+        return 1;
+    case OP_FORLOOP:
+        next[0] = jumptarget(p, pc);
+        return 1;
+    case OP_LT:
+    case OP_LE:
+        if (!numoperand(p, GETARG_B(i)) || !numoperand(p, GETARG_C(i)))
+            return -1;
+        /* FALLTHROUGH */
+    case OP_EQ:
+    case OP_TEST:
+    case OP_TESTSET:
+        *falls = 0;
+        next[0] = jumptarget(p, pc + 1);
+        next[1] = pc + 2;
+        return 2;
+    default: /* calls, closures, concatenation, ...: interpreter */
+        return -1;
+    }
+}
+
+/* emit instruction `pc', which `successors' accepts */
+static void genop(Gen *G, int pc) {
+    const Proto *p = G->p;
+    FILE *out = G->out;
+    Instruction i = p->code[pc];
+    int op = luaP_baseop[GET_OPCODE(i)];
+    int a = GETARG_A(i), b = GETARG_B(i), c = GETARG_C(i);
+    char sb[64], sc[64], cond[256];
+    switch (op) {
+    case OP_MOVE:
+        fprintf(out, "    setobjs2s(L, R(%d), R(%d));\n", a, b);
+        break;
+    case OP_LOADK:
+        fprintf(out, "    setobj2s(L, R(%d), K(%d));\n", a, GETARG_Bx(i));
+        break;
+    case OP_LOADBOOL:
+        fprintf(out, "    setbvalue(R(%d), %d);\n", a, b);
+        if (c)
+            fprintf(out, "    goto L%d;\n", pc + 2);
+        break;
+    case OP_LOADNIL:
+        for (int r = a; r <= b; r++)
+            fprintf(out, "    setnilvalue(R(%d));\n", r);
+        break;
+    case OP_GETUPVAL:
+        fprintf(out, "    setobj2s(L, R(%d), cl->upvals[%d]->v);\n", a, b);
+        break;
+    case OP_SETUPVAL:
+        fprintf(out,
+                "    {\n        UpVal *uv = cl->upvals[%d];\n"
+                "        setobj(L, uv->v, R(%d));\n"
+                "        luaC_barrier(L, uv, R(%d));\n    }\n",
+                b, a, a);
+        break;
+    case OP_GETGLOBAL:
+        fprintf(out, "    if (!luaV_fastget(L, cl->env, K(%d), R(%d)))"
+                     " return %d;\n",
+                GETARG_Bx(i), a, pc);
+        break;
+    case OP_SETGLOBAL:
+        fprintf(out, "    if (!luaV_fastset(L, cl->env, K(%d), R(%d)))"
+                     " return %d;\n",
+                GETARG_Bx(i), a, pc);
+        break;
+    case OP_GETTABLE:
+        fprintf(out,
+                "    if (!R(%d)->istable() ||\n"
+                "        !luaV_fastget(L, hvalue(R(%d)), %s, R(%d)))\n"
+                "        return %d;\n",
+                b, b, rk(c, sc), a, pc);
+        break;
+    case OP_SETTABLE:
+        fprintf(out,
+                "    if (!R(%d)->istable() ||\n"
+                "        !luaV_fastset(L, hvalue(R(%d)), %s, %s))\n"
+                "        return %d;\n",
+                a, a, rk(b, sb), rk(c, sc), pc);
+        break;
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+    case OP_POW:
+        numop(G, b, pc, sb);
+        numop(G, c, pc, sc);
+        fprintf(out, "    setnvalue(R(%d), %s(%s, %s));\n", a,
+                arithop[op - OP_ADD], sb, sc);
+        break;
+    case OP_UNM:
+        numop(G, b, pc, sb);
+        fprintf(out, "    setnvalue(R(%d), luai_numunm(%s));\n", a, sb);
+        break;
+    case OP_NOT:
+        fprintf(out, "    setbvalue(R(%d), R(%d)->isfalse());\n", a, b);
+        break;
+    case OP_LEN:
+        fprintf(out, "    if (!luaV_fastlen(R(%d), R(%d))) return %d;\n", b,
+                a, pc);
+        break;
+    case OP_JMP:
+        gotopc(G, pc, jumptarget(p, pc), 4);
+        break;
+    case OP_EQ:
+        fprintf(out,
+                "    {\n        int res = luaV_fasteq(%s, %s);\n"
+                "        if (res < 0) return %d;\n",
+                rk(b, sb), rk(c, sc), pc);
+        sprintf(cond, "res == %d", a);
+        condjump(G, pc, cond);
+        fprintf(out, "    }\n");
+        break;
+    case OP_LT:
+    case OP_LE:
+        numop(G, b, pc, sb);
+        numop(G, c, pc, sc);
+        sprintf(cond, "%s(%s, %s) == %d",
+                op == OP_LT ? "luai_numlt" : "luai_numle", sb, sc, a);
+        condjump(G, pc, cond);
+        break;
+    case OP_TEST:
+        sprintf(cond, "R(%d)->isfalse() != %d", a, c);
+        condjump(G, pc, cond);
+        break;
+    case OP_TESTSET:
+        fprintf(out, "    if (R(%d)->isfalse() != %d) {\n", b, c);
+        fprintf(out, "        setobjs2s(L, R(%d), R(%d));\n", a, b);
+        gotopc(G, pc, jumptarget(p, pc + 1), 8);
+        fprintf(out, "    }\n    goto L%d;\n", pc + 2);
+        break;
+    case OP_FORLOOP: {
+        char step[64], test[256];
+        int dir = forstep(p, pc, step);
+        if (dir > 0) /* direction known when compiling */
+            sprintf(test, "luai_numle(idx, nvalue(R(%d)))", a + 1);
+        else if (dir < 0)
+            sprintf(test, "luai_numle(nvalue(R(%d)), idx)", a + 1);
+        else {
+            sprintf(step, "nvalue(R(%d))", a + 2);
+            sprintf(test,
+                    "luai_numlt(0, %s) ? luai_numle(idx, nvalue(R(%d)))\n"
+                    "                              : "
+                    "luai_numle(nvalue(R(%d)), idx)",
+                    step, a + 1, a + 1);
+        }
+        fprintf(out,
+                "    {\n        lua_Number idx = "
+                "luai_numadd(nvalue(R(%d)), %s);\n"
+                "        if (%s) {\n"
+                "            setnvalue(R(%d), idx);\n"
+                "            setnvalue(R(%d), idx);\n",
+                a, step, test, a, a + 3);
+        gotopc(G, pc, jumptarget(p, pc), 12);
+        fprintf(out, "        }\n    }\n");
+        break;
+    }
+    case OP_FORPREP:
+        fprintf(out,
+                "    if (!R(%d)->isnumber() || !R(%d)->isnumber() ||\n"
+                "        !R(%d)->isnumber())\n        return %d;\n"
+                "    setnvalue(R(%d), luai_numsub(nvalue(R(%d)), "
+                "nvalue(R(%d))));\n    goto L%d;\n",
+                a, a + 1, a + 2, pc, a, a, a + 2, jumptarget(p, pc));
+        break;
+    }
+}
+
+/* }====================================================== */
+
+/*
+** generate the function for `p', number `n' in the tree; returns 0,
+** generating nothing, when none of its loops can run in compiled code
+*/
+static int genfunction(Gen *G, const Proto *p, int n) {
+    int size = p->sizecode;
+    char *entry = cast(char *, calloc(3 * size, 1));
+    char *label = entry + size; /* targets of `goto' */
+    char *reach = entry + 2 * size;
+    int *stack = cast(int *, malloc(size * sizeof(int)));
+    int top = 0, nentries = 0;
+    int next[2], falls;
+    if (entry == nullptr || stack == nullptr)
+        fatal("not enough memory");
+    /* the interpreter enters compiled code at loop back edges */
+    for (int pc = 0; pc < size; pc++) {
+        Instruction i = p->code[pc];
+        int op = luaP_baseop[GET_OPCODE(i)];
+        if (op == OP_SETLIST && GETARG_C(i) == 0)
+            pc++; /* skip its count word */
+        else if (op == OP_FORLOOP || (op == OP_JMP && GETARG_sBx(i) < 0)) {
+            int t = jumptarget(p, pc);
+            if (!entry[t] && successors(p, t, next, &falls) >= 0) {
+                entry[t] = label[t] = reach[t] = 1;
+                stack[top++] = t;
+                nentries++;
+            }
+        }
+    }
+    while (top > 0) { /* mark what compiled code may reach from there */
+        int pc = stack[--top];
+        int nn = successors(p, pc, next, &falls);
+        for (int j = 0; j < nn; j++) {
+            label[next[j]] = 1;
+            if (!reach[next[j]]) {
+                reach[next[j]] = 1;
+                stack[top++] = next[j];
+            }
+        }
+        if (nn >= 0 && falls && !reach[pc + 1]) {
+            reach[pc + 1] = 1;
+            stack[top++] = pc + 1;
+        }
+    }
+    if (nentries > 0) {
+        FILE *out = G->out;
+        G->p = p;
+        fprintf(out,
+                "\n/* function at line %d */\n"
+                "static int aot_%d(lua_State *L, StkId base, TValue *k, "
+                "LClosure *cl,\n                 int pc) {\n"
+                "    switch (pc) {\n",
+                p->linedefined, n);
+        for (int pc = 0; pc < size; pc++)
+            if (entry[pc])
+                fprintf(out, "    case %d:\n        goto L%d;\n", pc, pc);
+        fprintf(out, "    default:\n        return pc;\n    }\n");
+        for (int pc = 0; pc < size; pc++) {
+            Instruction i = p->code[pc];
+            if (!reach[pc])
+                continue;
+            if (label[pc])
+                fprintf(out, "L%d:\n", pc);
+            fprintf(out, "    /* [%d] %s", pc + 1,
+                    luaP_opnames[luaP_baseop[GET_OPCODE(i)]]);
+            if (p->lineinfo != nullptr)
+                fprintf(out, " (line %d)", p->lineinfo[pc]);
+            fprintf(out, " */\n");
+            if (successors(p, pc, next, &falls) >= 0)
+                genop(G, pc);
+            else
+                fprintf(out, "    return %d;\n", pc);
+        }
+        fprintf(out, "}\n");
+    }
+    free(entry);
+    free(stack);
+    return nentries > 0;
+}
+
+static int countprotos(const Proto *p) {
+    int n = 1;
+    for (int i = 0; i < p->sizep; i++)
+        n += countprotos(p->p[i]);
+    return n;
+}
+
+/* generate the functions of the tree of `p' in preorder */
+static void genprotos(Gen *G, const Proto *p, char *has, int *n) {
+    int self = (*n)++;
+    has[self] = cast(char, genfunction(G, p, self));
+    for (int i = 0; i < p->sizep; i++)
+        genprotos(G, p->p[i], has, n);
+}
+
+static int writer(lua_State *L, const void *b, size_t size, void *ud) {
+    Gen *G = cast(Gen *, ud);
+    const unsigned char *s = cast(const unsigned char *, b);
+    UNUSED(L);
+    for (size_t i = 0; i < size; i++, G->nbytes++)
+        fprintf(G->out, "%s%u,", (G->nbytes % 16 == 0) ? "\n   " : "", s[i]);
+    return 0;
+}
+
+static void generate(lua_State *L, FILE *out, const char *name,
+                     const char *id, const char *input) {
+    const Proto *f = clvalue(L->top - 1)->l.p;
+    Gen G;
+    int n = 0, total = countprotos(f);
+    char *has = cast(char *, malloc(total));
+    if (has == nullptr)
+        fatal("not enough memory");
+    G.out = out;
+    G.p = f;
+    G.nbytes = 0;
+    fprintf(out,
+            R"(/* module `%s', compiled by luaot from %s */
+
+#define LUA_CORE
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "ldebug.h"
+#include "lgc.h"
+#include "lobject.h"
+#include "lstate.h"
+#include "lvm.h"
+
+#if LUA_INTSUBTYPE
+#error "luaot output needs a build without LUA_INTSUBTYPE"
+#endif
+
+#define R(x) (base + (x))
+#define K(x) (k + (x))
+)",
+            name, input);
+    genprotos(&G, f, has, &n);
+    fprintf(out, "\nstatic const AotCode code[] = {");
+    for (int i = 0; i < total; i++) {
+        if (i % 4 == 0)
+            fprintf(out, "\n   ");
+        if (has[i])
+            fprintf(out, " aot_%d,", i);
+        else
+            fprintf(out, " nullptr,");
+    }
+    fprintf(out, "\n};\n\nstatic const unsigned char chunk[] = {");
+    lua_dump(L, writer, &G);
+    fprintf(out,
+            R"(
+};
+
+static void attach(Proto *p, int *n) {
+    p->aot = code[(*n)++];
+    for (int i = 0; i < p->sizep; i++)
+        attach(p->p[i], n);
+}
+
+static int load(lua_State *L) {
+    int n = 0;
+    if (luaL_loadbuffer(L, reinterpret_cast<const char *>(chunk),
+                        sizeof(chunk), "=%s") != 0)
+        return lua_error(L);
+    attach(clvalue(L->top - 1)->l.p, &n);
+    lua_pushvalue(L, 1); /* module name */
+    lua_call(L, 1, 1);
+    return 1;
+}
+
+void luaot_preload_%s(lua_State *L) {
+    lua_getfield(L, LUA_GLOBALSINDEX, "package");
+    lua_getfield(L, -1, "preload");
+    lua_pushcfunction(L, load);
+    lua_setfield(L, -2, "%s");
+    lua_pop(L, 2);
+}
+)",
+            name, id, name);
+    free(has);
+}
+
+int main(int argc, char *argv[]) {
+    const char *name = nullptr, *output = nullptr, *input = nullptr;
+    char buff[256], id[256];
+    if (argv[0] != nullptr && argv[0][0] != '\0')
+        progname = argv[0];
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            name = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else if (argv[i][0] == '-' || input != nullptr)
+            usage(nullptr);
+        else
+            input = argv[i];
+    }
+    if (input == nullptr)
+        usage("no input file given");
+    if (name == nullptr) { /* file name without directory and extension */
+        const char *base = strrchr(input, '/');
+        base = (base == nullptr) ? input : base + 1;
+        snprintf(buff, sizeof(buff), "%s", base);
+        char *dot = strrchr(buff, '.');
+        if (dot != nullptr && strcmp(dot, ".lua") == 0)
+            *dot = '\0';
+        name = buff;
+    }
+    if (name[0] == '\0' || strlen(name) >= sizeof(id))
+        usage("bad module name");
+    for (int i = 0; name[i] != '\0'; i++) {
+        unsigned char ch = cast(unsigned char, name[i]);
+        if (!isalnum(ch) && ch != '_' && ch != '.' && ch != '-')
+            usage("bad module name");
+        id[i] = isalnum(ch) ? name[i] : '_';
+        id[i + 1] = '\0';
+    }
+    lua_State *L = luaL_newstate();
+    if (L == nullptr)
+        fatal("cannot create state: not enough memory");
+    if (luaL_loadfile(L, input) != 0)
+        fatal(lua_tostring(L, -1));
+    FILE *out = (output == nullptr) ? stdout : fopen(output, "w");
+    if (out == nullptr)
+        fatal("cannot open output file");
+    generate(L, out, name, id, input);
+    if (ferror(out) || (output != nullptr && fclose(out) != 0))
+        fatal("cannot write output file");
+    lua_close(L);
+    return EXIT_SUCCESS;
+}
@@ -5,6 +5,7 @@
 
 #include "lua.h"
 
+#include "lcode.h"
 #include "ldebug.h"
 #include "ldo.h"
 #include "lfunc.h"
@@ -53,6 +54,14 @@ static int LoadInt(LoadState *S) {
     return x;
 }
 
+#if LUA_INTSUBTYPE
+static l_int64 LoadInteger(LoadState *S) {
+    l_int64 x;
+    LoadVar(S, x);
+    return x;
+}
+#endif
+
 static lua_Number LoadNumber(LoadState *S) {
     lua_Number x;
     LoadVar(S, x);
@@ -100,6 +109,11 @@ static void LoadConstants(LoadState *S, Proto *f) {
         case LUA_TNUMBER:
             setnvalue(o, LoadNumber(S));
             break;
+#if LUA_INTSUBTYPE
+        case LUA_TNUMINT:
+            setivalue(o, LoadInteger(S));
+            break;
+#endif
         case LUA_TSTRING:
             setsvalue2n(S->L, o, LoadString(S));
             break;
@@ -159,6 +173,8 @@ static Proto *LoadFunction(LoadState *S, TString *p) {
     LoadConstants(S, f);
     LoadDebug(S, f);
     IF(!luaG_checkcode(f), "bad code");
+    luaK_fuse(f);
+    luaF_initcache(S->L, f);
     S->L->top--;
     return f;
 }
@@ -11,6 +11,7 @@
 #include "ldo.h"
 #include "lfunc.h"
 #include "lgc.h"
+#include "ljit.h"
 #include "lobject.h"
 #include "lopcodes.h"
 #include "lstate.h"
@@ -22,11 +23,24 @@
 /* limit for table tag-method chains (to avoid loops) */
 #define MAXTAGLOOP 100
 
-const TValue *luaV_tonumber(const TValue *obj, TValue *n) {
+/*
+** use a jump table (labels as values) to dispatch opcodes in `luaV_execute',
+** when the compiler supports it; otherwise fall back to a plain switch
+*/
+#if !defined(LUA_USE_JUMPTABLE)
+#if defined(__GNUC__)
+#define LUA_USE_JUMPTABLE 1
+#else
+#define LUA_USE_JUMPTABLE 0
+#endif
+#endif
+
+const TValue *luaV_tonumber(lua_State *L, const TValue *obj, TValue *n) {
     lua_Number num;
     if (obj->isnumber())
         return obj;
-    if (obj->isstring() && luaO_str2d(svalue(obj), &num)) {
+    if (obj->isstring() &&
+        luaO_str2d(luaS_flatten(L, rawtsvalue(obj)), &num)) {
         setnvalue(n, num);
         return n;
     } else
@@ -38,8 +52,15 @@ int luaV_tostring(lua_State *L, StkId obj) {
         return 0;
     else {
         char s[LUAI_MAXNUMBER2STR];
-        lua_Number n = nvalue(obj);
-        lua_number2str(s, n);
+#if LUA_INTSUBTYPE
+        if (ttisint(obj))
+            lua_int2str(s, ivalue(obj));
+        else
+#endif
+        {
+            lua_Number n = nvalue(obj);
+            lua_number2str(s, n);
+        }
         setsvalue2s(L, obj, luaS_new(L, s));
         return 1;
     }
@@ -91,6 +112,43 @@ static void callTM(lua_State *L, const TValue *f, const TValue *p1,
     luaD_call(L, L->top - 4, 0);
 }
 
+/*
+** Resolve string `key' through the chain of `__index' tables starting at
+** `h', the `__index' field of metatable `mt'. Returns nullptr if the
+** chain reaches an `__index' that is not a table (it cannot be cached).
+*/
+static const TValue *cachedindex(lua_State *L, Table *mt, Table *h,
+                                 TString *key) {
+    global_State *g = G(L);
+    IndexCache *e = luaT_idxslot(g, mt, key);
+    if (e->version == g->idxversion && e->mt == mt && e->key == key)
+        return &e->val;
+    mt->cached = 1;
+    const TValue *res;
+    for (int loop = 0; loop < MAXTAGLOOP; loop++) {
+        h->cached = 1;
+        res = luaH_getstr(h, key);
+        if (!res->isnil() || h->metatable == nullptr)
+            break;
+        Table *m = h->metatable;
+        m->cached = 1; /* the result depends on whether it has `__index' */
+        const TValue *tm = fasttm(L, m, TM_INDEX);
+        if (tm == nullptr)
+            break;
+        if (!tm->istable())
+            return nullptr;
+        h = hvalue(tm);
+        res = nullptr;
+    }
+    if (res == nullptr) /* loop in gettable: let the caller raise it */
+        return nullptr;
+    e->mt = mt;
+    e->key = key;
+    setobj(L, &e->val, res);
+    e->version = g->idxversion;
+    return &e->val;
+}
+
 void luaV_gettable(lua_State *L, const TValue *t, TValue *key, StkId val) {
     int loop;
     for (loop = 0; loop < MAXTAGLOOP; loop++) {
@@ -105,6 +163,13 @@ void luaV_gettable(lua_State *L, const TValue *t, TValue *key, StkId val) {
                 return;
             }
             /* else will try the tag method */
+            if (tm->istable() && key->isstring()) {
+                res = cachedindex(L, h->metatable, hvalue(tm), rawtsvalue(key));
+                if (res != nullptr) {
+                    setobj2s(L, val, res);
+                    return;
+                }
+            }
         } else if ((tm = luaT_gettmbyobj(L, t, TM_INDEX))->isnil())
             luaG_typeerror(L, t, "index");
         if (tm->isfunction()) {
@@ -122,6 +187,11 @@ void luaV_settable(lua_State *L, const TValue *t, TValue *key, StkId val) {
         const TValue *tm;
         if (t->istable()) { /* `t' is a table? */
             Table *h = hvalue(t);
+            if (ispacked(h) && val->isnumber() &&
+                fasttm(L, h->metatable, TM_NEWINDEX) == nullptr) {
+                luaH_setobj(L, h, key, val); /* keeps the array part packed */
+                return;
+            }
             TValue *oldval = luaH_set(L, h, key); /* do a primitive set */
             if (!oldval->isnil() ||               /* result is no nil? */
                 (tm = fasttm(L, h->metatable, TM_NEWINDEX)) ==
@@ -142,6 +212,74 @@ void luaV_settable(lua_State *L, const TValue *t, TValue *key, StkId val) {
     luaG_runerror(L, "loop in settable");
 }
 
+/*
+** Operations for compiled code (ljit.cpp, luaot.cpp): they never raise
+** errors, allocate or call metamethods, and return 0 (or -1 for
+** `luaV_fasteq') when the interpreter must do the full operation
+*/
+
+int luaV_fastget(lua_State *L, Table *h, const TValue *key, StkId val) {
+    Value *pv = luaH_packedslot(h, key);
+    if (pv != nullptr && !packednil(pv)) {
+        setnvalue(val, pv->n);
+        return 1;
+    }
+    const TValue *res = luaH_get(h, key);
+    if (res->isnil() && fasttm(L, h->metatable, TM_INDEX) != nullptr)
+        return 0;
+    setobj2s(L, val, res);
+    return 1;
+}
+
+/* only an existing key without `__newindex': no allocation */
+int luaV_fastset(lua_State *L, Table *h, const TValue *key,
+                 const TValue *val) {
+    Value *pv = luaH_packedslot(h, key);
+    if (pv != nullptr) { /* a packed slot takes only numbers */
+        if (!val->isnumber() ||
+            (packednil(pv) && fasttm(L, h->metatable, TM_NEWINDEX) != nullptr))
+            return 0;
+        setpackednum(pv, nvalue(val));
+        return 1;
+    }
+    TValue *old = cast(TValue *, luaH_get(h, key));
+    if (old == luaO_nilobject ||
+        (old->isnil() && fasttm(L, h->metatable, TM_NEWINDEX) != nullptr))
+        return 0;
+    if (old->isnil()) /* a field that was absent: as in `luaH_set' */
+        h->flags = 0;
+    if (key->isstring())
+        luaT_tablewrite(G(L), h);
+    setobj2t(L, old, val);
+    luaC_barriert(L, h, val);
+    return 1;
+}
+
+int luaV_fastlen(const TValue *rb, StkId ra) {
+    if (rb->istable()) {
+        setivalue(ra, luaH_getn(hvalue(rb)));
+    } else if (rb->isstring()) {
+        setivalue(ra, tsvalue(rb)->len);
+    } else
+        return 0;
+    return 1;
+}
+
+int luaV_fasteq(const TValue *t1, const TValue *t2) {
+    if (ttype(t1) != ttype(t2))
+        return 0;
+    else if (t1->istable()) {
+        if (hvalue(t1) == hvalue(t2))
+            return 1;
+        return (hvalue(t1)->metatable || hvalue(t2)->metatable) ? -1 : 0;
+    } else if (ttype(t1) == LUA_TUSERDATA) {
+        if (uvalue(t1) == uvalue(t2))
+            return 1;
+        return (uvalue(t1)->metatable || uvalue(t2)->metatable) ? -1 : 0;
+    }
+    return luaO_rawequalObj(t1, t2);
+}
+
 static int call_binTM(lua_State *L, const TValue *p1, const TValue *p2,
                       StkId res, TMS event) {
     const TValue *tm = luaT_gettmbyobj(L, p1, event); /* try first operand */
@@ -182,10 +320,10 @@ static int call_orderTM(lua_State *L, const TValue *p1, const TValue *p2,
     return !(L->top)->isfalse();
 }
 
-static int l_strcmp(const TString *ls, const TString *rs) {
-    const char *l = getstr(ls);
+static int l_strcmp(lua_State *L, TString *ls, TString *rs) {
+    const char *l = luaS_flatten(L, ls);
     size_t ll = ls->len;
-    const char *r = getstr(rs);
+    const char *r = luaS_flatten(L, rs);
     size_t lr = rs->len;
     for (;;) {
         int temp = strcoll(l, r);
@@ -208,14 +346,76 @@ static int l_strcmp(const TString *ls, const TString *rs) {
     }
 }
 
+#if LUA_INTSUBTYPE
+/*
+** exact order between integers and floats: an integer compares with the
+** nearest integral values around a float (NaN is never ordered)
+*/
+static int intltflt(l_int64 i, lua_Number f) {
+    if (f >= -cast_num(MIN_LINT64))
+        return 1;
+    else if (f > cast_num(MIN_LINT64))
+        return i < cast(l_int64, ceil(f));
+    return 0;
+}
+
+static int intleflt(l_int64 i, lua_Number f) {
+    if (f >= -cast_num(MIN_LINT64))
+        return 1;
+    else if (f >= cast_num(MIN_LINT64))
+        return i <= cast(l_int64, floor(f));
+    return 0;
+}
+
+static int fltltint(lua_Number f, l_int64 i) {
+    if (f >= -cast_num(MIN_LINT64))
+        return 0;
+    else if (f >= cast_num(MIN_LINT64))
+        return cast(l_int64, floor(f)) < i;
+    return f < cast_num(MIN_LINT64); /* false for NaN */
+}
+
+static int fltleint(lua_Number f, l_int64 i) {
+    if (f >= -cast_num(MIN_LINT64))
+        return 0;
+    else if (f > cast_num(MIN_LINT64))
+        return cast(l_int64, ceil(f)) <= i;
+    return f <= cast_num(MIN_LINT64); /* false for NaN */
+}
+
+static inline int numlt(const TValue *l, const TValue *r) {
+    if (ttisint(l))
+        return ttisint(r) ? ivalue(l) < ivalue(r)
+                          : intltflt(ivalue(l), fltvalue(r));
+    else if (ttisint(r))
+        return fltltint(fltvalue(l), ivalue(r));
+    return luai_numlt(fltvalue(l), fltvalue(r));
+}
+
+static inline int numle(const TValue *l, const TValue *r) {
+    if (ttisint(l))
+        return ttisint(r) ? ivalue(l) <= ivalue(r)
+                          : intleflt(ivalue(l), fltvalue(r));
+    else if (ttisint(r))
+        return fltleint(fltvalue(l), ivalue(r));
+    return luai_numle(fltvalue(l), fltvalue(r));
+}
+
+#define numeq(l, r) luaO_numeq(l, r)
+#else
+#define numlt(l, r) luai_numlt(nvalue(l), nvalue(r))
+#define numle(l, r) luai_numle(nvalue(l), nvalue(r))
+#define numeq(l, r) luai_numeq(nvalue(l), nvalue(r))
+#endif
+
 int luaV_lessthan(lua_State *L, const TValue *l, const TValue *r) {
     int res;
     if (ttype(l) != ttype(r))
         return luaG_ordererror(L, l, r);
     else if (l->isnumber())
-        return luai_numlt(nvalue(l), nvalue(r));
+        return numlt(l, r);
     else if (l->isstring())
-        return l_strcmp(rawtsvalue(l), rawtsvalue(r)) < 0;
+        return l_strcmp(L, rawtsvalue(l), rawtsvalue(r)) < 0;
     else if ((res = call_orderTM(L, l, r, TM_LT)) != -1)
         return res;
     return luaG_ordererror(L, l, r);
@@ -226,9 +426,9 @@ static int lessequal(lua_State *L, const TValue *l, const TValue *r) {
     if (ttype(l) != ttype(r))
         return luaG_ordererror(L, l, r);
     else if (l->isnumber())
-        return luai_numle(nvalue(l), nvalue(r));
+        return numle(l, r);
     else if (l->isstring())
-        return l_strcmp(rawtsvalue(l), rawtsvalue(r)) <= 0;
+        return l_strcmp(L, rawtsvalue(l), rawtsvalue(r)) <= 0;
     else if ((res = call_orderTM(L, l, r, TM_LE)) != -1) /* first try `le' */
         return res;
     else if ((res = call_orderTM(L, r, l, TM_LT)) != -1) /* else try `lt' */
@@ -242,11 +442,13 @@ int luaV_equalval(lua_State *L, const TValue *t1, const TValue *t2) {
     case LUA_TNIL:
         return 1;
     case LUA_TNUMBER:
-        return luai_numeq(nvalue(t1), nvalue(t2));
+        return numeq(t1, t2);
     case LUA_TBOOLEAN:
         return bvalue(t1) == bvalue(t2); /* true must be 1 !! */
     case LUA_TLIGHTUSERDATA:
         return pvalue(t1) == pvalue(t2);
+    case LUA_TSTRING:
+        return luaS_eqstr(rawtsvalue(t1), rawtsvalue(t2));
     case LUA_TUSERDATA: {
         if (uvalue(t1) == uvalue(t2))
             return 1;
@@ -285,26 +487,94 @@ void luaV_concat(lua_State *L, int total, int last) {
                     luaG_runerror(L, "string length overflow");
                 tl += l;
             }
-            char *buffer = luaZ_openspace(L, &G(L)->buff, tl);
-            tl = 0;
-            for (int i = n; i > 0; i--) { /* concat all strings */
-                size_t l = tsvalue(top - i)->len;
-                memcpy(buffer + tl, svalue(top - i), l);
-                tl += l;
+            TString *first = rawtsvalue(top - n);
+            if (islongstr(first)) { /* append to it (in place, if it can) */
+                TString *ts = luaS_extend(L, first, tl);
+                char *buffer = cast(char *, getstr(ts));
+                tl = first->len;
+                for (int i = n - 1; i > 0; i--) {
+                    size_t l = tsvalue(top - i)->len;
+                    memcpy(buffer + tl, svalue(top - i), l);
+                    tl += l;
+                }
+                setsvalue2s(L, top - n, ts);
+            } else {
+                char *buffer = luaZ_openspace(L, &G(L)->buff, tl);
+                tl = 0;
+                for (int i = n; i > 0; i--) { /* concat all strings */
+                    size_t l = tsvalue(top - i)->len;
+                    memcpy(buffer + tl, svalue(top - i), l);
+                    tl += l;
+                }
+                setsvalue2s(L, top - n, luaS_newlstr(L, buffer, tl));
             }
-            setsvalue2s(L, top - n, luaS_newlstr(L, buffer, tl));
         }
         total -= n - 1; /* got `n' strings to create 1 new */
         last -= n - 1;
     } while (total > 1); /* repeat until only 1 result left */
 }
 
+#if LUA_INTSUBTYPE
+/*
+** integer arithmetic: stores the result in `ra' and returns 1 when it is
+** exact; otherwise returns 0 and the caller computes it with floats
+*/
+static inline int intarith(TMS op, l_int64 a, l_int64 b, TValue *ra) {
+    l_int64 r;
+    int ok;
+    switch (op) {
+    case TM_ADD:
+        ok = luaO_intadd(a, b, &r);
+        break;
+    case TM_SUB:
+        ok = luaO_intsub(a, b, &r);
+        break;
+    case TM_MUL:
+        ok = luaO_intmul(a, b, &r);
+        break;
+    case TM_MOD:
+        ok = luaO_intmod(a, b, &r);
+        break;
+    case TM_UNM:
+        ok = luaO_intunm(a, &r);
+        break;
+    default: /* division and power always give floats */
+        return 0;
+    }
+    if (ok)
+        setivalue(ra, r);
+    return ok;
+}
+#endif
+
+#if LUA_INTSUBTYPE
+/*
+** an integer loop needs an integer limit: a float limit is rounded towards
+** the start, so that the loop runs over the same values. Limits out of the
+** integer range keep a float loop.
+*/
+static int forlimit(TValue *lim, l_int64 step) {
+    l_int64 i;
+    if (ttisint(lim))
+        return 1;
+    lua_Number f = fltvalue(lim);
+    if (!luaO_flt2int(0 < step ? floor(f) : ceil(f), &i))
+        return 0;
+    setivalue(lim, i);
+    return 1;
+}
+#endif
+
 static void Arith(lua_State *L, StkId ra, const TValue *rb, const TValue *rc,
                   TMS op) {
     TValue tempb, tempc;
     const TValue *b, *c;
-    if ((b = luaV_tonumber(rb, &tempb)) != nullptr &&
-        (c = luaV_tonumber(rc, &tempc)) != nullptr) {
+    if ((b = luaV_tonumber(L, rb, &tempb)) != nullptr &&
+        (c = luaV_tonumber(L, rc, &tempc)) != nullptr) {
+#if LUA_INTSUBTYPE
+        if (ttisint(b) && ttisint(c) && intarith(op, ivalue(b), ivalue(c), ra))
+            return;
+#endif
         lua_Number nb = nvalue(b), nc = nvalue(c);
         switch (op) {
         case TM_ADD:
@@ -335,6 +605,29 @@ static void Arith(lua_State *L, StkId ra, const TValue *rb, const TValue *rc,
         luaG_aritherror(L, rb, rc);
 }
 
+/*
+** inline cache lookup of string `key' in `h': `*slot' is the node where
+** this instruction found the key last time. A node that still holds `key'
+** is its only entry in `h', so no other validation is needed. Returns
+** nullptr if the key is absent.
+*/
+static inline TValue *cachedstr(Table *h, TString *key, int *slot) {
+    if (*slot < sizenode(h)) {
+        Node *n = gnode(h, *slot);
+        if (keyisstring(n) && keystrval(n) == key)
+            return gval(n);
+    }
+    int s = luaH_strslot(h, key);
+    if (s < 0) {
+        if (h->old == nullptr)
+            return nullptr;
+        const TValue *v = luaH_getstr(h->old, key); /* not moved yet? */
+        return (v == luaO_nilobject) ? nullptr : cast(TValue *, v);
+    }
+    *slot = s;
+    return gval(gnode(h, s));
+}
+
 /*
 ** some macros for common tasks in `luaV_execute'
 */
@@ -342,7 +635,7 @@ static void Arith(lua_State *L, StkId ra, const TValue *rb, const TValue *rc,
 #define runtime_check(L, c)                                                    \
     {                                                                          \
         if (!(c))                                                              \
-            break;                                                             \
+            vmbreak;                                                           \
     }
 
 #define RA(i) (base + GETARG_A(i))
@@ -366,10 +659,90 @@ static void Arith(lua_State *L, StkId ra, const TValue *rb, const TValue *rc,
         base = L->base;                                                        \
     }
 
+/*
+** fetch next instruction (running the line/count hooks, in the hooked
+** variant) and compute `ra'
+*/
+#define vmfetch()                                                              \
+    {                                                                          \
+        i = *pc++;                                                             \
+        if (hooked && hasinstrhook(L) &&                                       \
+            (--L->hookcount == 0 || L->hookmask & LUA_MASKLINE)) {             \
+            traceexec(L, pc);                                                  \
+            if (L->status == LUA_YIELD) { /* did hook yield? */                \
+                L->savedpc = pc - 1;                                           \
+                return 0;                                                      \
+            }                                                                  \
+            base = L->base;                                                    \
+        }                                                                      \
+        /* warning!! several calls may realloc the stack and invalidate `ra' */\
+        ra = RA(i);                                                            \
+    }
+
+/*
+** a loop back edge: continue in the code compiled ahead of time for the
+** function (see luaot.cpp) or, once the JIT has compiled the loop, in its
+** machine code (see ljit.h), until it leaves compiled code
+*/
+#if LUA_USE_JIT
+#define jitloop(p)                                                             \
+    {                                                                          \
+        if ((p)->jit == nullptr && (p)->hotcount > 0 && --(p)->hotcount == 0)  \
+            luaJ_compile(L, p);                                                \
+        if (luaJ_hasentry(p, pc))                                              \
+            pc = luaJ_run(L, cl, base, pc);                                    \
+    }
+#else
+#define jitloop(p) ((void)0)
+#endif
+
+#define nativeloop()                                                           \
+    if (!hooked) {                                                             \
+        Proto *np = cl->p;                                                     \
+        if (np->aot != nullptr)                                                \
+            pc = np->code + np->aot(L, base, k, cl, cast_int(pc - np->code));  \
+        else                                                                   \
+            jitloop(np);                                                       \
+    }
+
+/*
+** the hook mask is only checked at safe points (function entry, return from
+** C calls and jumps); when it no longer matches the running variant, save
+** the state and return to `luaV_execute', which switches variants
+*/
+#define vmsafepoint()                                                          \
+    {                                                                          \
+        if (hasinstrhook(L) != hooked) {                                       \
+            L->savedpc = pc;                                                   \
+            *pnexeccalls = nexeccalls;                                         \
+            return 1;                                                          \
+        }                                                                      \
+    }
+
+/* dispatch macros for the plain `switch' (see `ljumptab.h' for the others) */
+#define vmdispatch(o) switch (o)
+#define vmcase(l) case l:
+#define vmbreak continue
+#define vmnext(o) continue
+
+/*
+** integer fast path of the arithmetic opcodes: falls through when an
+** operand is not an integer or the result overflows
+*/
+#if LUA_INTSUBTYPE
+#define intarith_op(tm, rb, rc)                                                \
+    if (ttisint(rb) && ttisint(rc) &&                                          \
+        intarith(tm, ivalue(rb), ivalue(rc), ra))                              \
+        vmbreak;
+#else
+#define intarith_op(tm, rb, rc)
+#endif
+
 #define arith_op(op, tm)                                                       \
     {                                                                          \
         TValue *rb = RKB(i);                                                   \
         TValue *rc = RKC(i);                                                   \
+        intarith_op(tm, rb, rc)                                                \
         if (rb->isnumber() && rc->isnumber()) {                                \
             lua_Number nb = nvalue(rb), nc = nvalue(rc);                       \
             setnvalue(ra, op(nb, nc));                                         \
@@ -377,147 +750,278 @@ static void Arith(lua_State *L, StkId ra, const TValue *rb, const TValue *rc,
             Protect(Arith(L, ra, rb, rc, tm));                                 \
     }
 
-void luaV_execute(lua_State *L, int nexeccalls) {
+/* inline cache slot of the running instruction */
+#define icslot() (&cl->p->icache[pc - 1 - cl->p->code])
+
+/* rewrite the running instruction into (specialized) opcode `o' */
+#define quicken(o) SET_OPCODE(*cast(Instruction *, pc - 1), (o))
+
+/*
+** generic arithmetic that specializes itself when it sees numbers in
+** registers: into `qnn' (two registers) or `qnk' (register and constant)
+*/
+#define arith_opq(op, tm, qnn, qnk)                                            \
+    {                                                                          \
+        TValue *rb = RKB(i);                                                   \
+        TValue *rc = RKC(i);                                                   \
+        if (rb->isnumber() && rc->isnumber()) {                                \
+            if (!ISK(GETARG_B(i)))                                             \
+                quicken(ISK(GETARG_C(i)) ? (qnk) : (qnn));                     \
+            intarith_op(tm, rb, rc)                                            \
+            lua_Number nb = nvalue(rb), nc = nvalue(rc);                       \
+            setnvalue(ra, op(nb, nc));                                         \
+        } else                                                                 \
+            Protect(Arith(L, ra, rb, rc, tm));                                 \
+    }
+
+/* specialized arithmetic; goes back to the generic `o' if a guard fails */
+#define arith_nn(op, tm, o)                                                    \
+    {                                                                          \
+        TValue *rb = RB(i);                                                    \
+        TValue *rc = RC(i);                                                    \
+        intarith_op(tm, rb, rc)                                                \
+        if (rb->isnumber() && rc->isnumber()) {                                \
+            lua_Number nb = nvalue(rb), nc = nvalue(rc);                       \
+            setnvalue(ra, op(nb, nc));                                         \
+        } else {                                                               \
+            quicken(o);                                                        \
+            Protect(Arith(L, ra, rb, rc, tm));                                 \
+        }                                                                      \
+    }
+
+#define arith_nk(op, tm, o)                                                    \
+    {                                                                          \
+        TValue *rb = RB(i);                                                    \
+        TValue *rc = k + INDEXK(GETARG_C(i)); /* always a number */            \
+        intarith_op(tm, rb, rc)                                                \
+        if (rb->isnumber()) {                                                  \
+            lua_Number nb = nvalue(rb), nc = nvalue(rc);                       \
+            setnvalue(ra, op(nb, nc));                                         \
+        } else {                                                               \
+            quicken(o);                                                        \
+            Protect(Arith(L, ra, rb, rc, tm));                                 \
+        }                                                                      \
+    }
+
+/*
+** bodies of the opcodes that start superinstructions: `next' goes on with
+** the following instruction (see `luaK_fuse')
+*/
+#define getglobal_op(next)                                                     \
+    {                                                                          \
+        TValue *rb = KBx(i);                                                   \
+        TValue *v = cachedstr(cl->env, rawtsvalue(rb), icslot());              \
+        if (v != nullptr && !v->isnil()) {                                     \
+            setobj2s(L, ra, v);                                                \
+        } else {                                                               \
+            TValue g;                                                          \
+            sethvalue(L, &g, cl->env);                                         \
+            Protect(luaV_gettable(L, &g, rb, ra));                             \
+        }                                                                      \
+        next;                                                                  \
+    }
+
+#define gettable_op(next)                                                      \
+    {                                                                          \
+        TValue *rb = RB(i);                                                    \
+        TValue *rc = RKC(i);                                                   \
+        if (rb->istable() && ISK(GETARG_C(i)) && rc->isstring()) {             \
+            TValue *v = cachedstr(hvalue(rb), rawtsvalue(rc), icslot());       \
+            if (v != nullptr && !v->isnil()) { /* no need for __index */       \
+                setobj2s(L, ra, v);                                            \
+                next;                                                          \
+            }                                                                  \
+        } else if (rb->istable()) {                                            \
+            Value *pv = luaH_packedslot(hvalue(rb), rc);                       \
+            if (pv != nullptr && !packednil(pv)) {                             \
+                setnvalue(ra, pv->n);                                          \
+                next;                                                          \
+            }                                                                  \
+        }                                                                      \
+        Protect(luaV_gettable(L, rb, rc, ra));                                 \
+        next;                                                                  \
+    }
+
+#define settable_op(next)                                                      \
+    {                                                                          \
+        TValue *rb = RKB(i);                                                   \
+        TValue *rc = RKC(i);                                                   \
+        if (ra->istable() && ISK(GETARG_B(i)) && rb->isstring()) {             \
+            Table *h = hvalue(ra);                                             \
+            TValue *v = cachedstr(h, rawtsvalue(rb), icslot());                \
+            if (v != nullptr && !v->isnil()) { /* no need for __newindex */    \
+                luaT_tablewrite(G(L), h);                                      \
+                setobj2t(L, v, rc);                                            \
+                luaC_barriert(L, h, rc);                                       \
+                next;                                                          \
+            }                                                                  \
+        } else if (ra->istable() && rc->isnumber()) {                          \
+            Table *h = hvalue(ra);                                             \
+            Value *pv = luaH_packedslot(h, rb);                                \
+            if (pv != nullptr &&                                               \
+                (!packednil(pv) || h->metatable == nullptr)) {                 \
+                setpackednum(pv, nvalue(rc));                                  \
+                next;                                                          \
+            }                                                                  \
+        }                                                                      \
+        Protect(luaV_settable(L, ra, rb, rc));                                 \
+        next;                                                                  \
+    }
+
+#define self_op(next)                                                          \
+    {                                                                          \
+        StkId rb = RB(i);                                                      \
+        TValue *rc = RKC(i);                                                   \
+        setobjs2s(L, ra + 1, rb);                                              \
+        if (rb->istable() && ISK(GETARG_C(i)) && rc->isstring()) {             \
+            TValue *v = cachedstr(hvalue(rb), rawtsvalue(rc), icslot());       \
+            if (v != nullptr && !v->isnil()) {                                 \
+                setobj2s(L, ra, v);                                            \
+                next;                                                          \
+            }                                                                  \
+        }                                                                      \
+        Protect(luaV_gettable(L, rb, rc, ra));                                 \
+        next;                                                                  \
+    }
+
+/*
+** The interpreter loop comes in two variants: `hooked' runs the line and
+** count hooks before each instruction; the other one pays nothing for them.
+** Returns 1 when the hooks changed and the other variant must take over
+** (at `L->savedpc'), 0 when done.
+*/
+template <bool hooked> static int execute(lua_State *L, int *pnexeccalls) {
+    int nexeccalls = *pnexeccalls;
     LClosure *cl;
     StkId base;
     TValue *k;
     const Instruction *pc;
+    Instruction i;
+    StkId ra;
+#if LUA_USE_JUMPTABLE
+#include "ljumptab.h"
+#endif
 reentry: /* entry point */
     pc = L->savedpc;
     cl = &clvalue(L->ci->func)->l;
     base = L->base;
     k = cl->p->k;
+    vmsafepoint();
     /* main loop of interpreter */
     for (;;) {
-        const Instruction i = *pc++;
-        StkId ra;
-        if ((L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) &&
-            (--L->hookcount == 0 || L->hookmask & LUA_MASKLINE)) {
-            traceexec(L, pc);
-            if (L->status == LUA_YIELD) { /* did hook yield? */
-                L->savedpc = pc - 1;
-                return;
-            }
-            base = L->base;
-        }
-        /* warning!! several calls may realloc the stack and invalidate `ra' */
-        ra = RA(i);
-        switch (GET_OPCODE(i)) {
-        case OP_MOVE: {
+        vmfetch();
+        vmdispatch(GET_OPCODE(i)) {
+        vmcase(OP_MOVE) {
             setobjs2s(L, ra, RB(i));
-            continue;
+            vmbreak;
         }
-        case OP_LOADK: {
+        vmcase(OP_LOADK) {
             setobj2s(L, ra, KBx(i));
-            continue;
+            vmbreak;
         }
-        case OP_LOADBOOL: {
+        vmcase(OP_LOADBOOL) {
             setbvalue(ra, GETARG_B(i));
             if (GETARG_C(i))
                 pc++; /* skip next instruction (if C) */
-            continue;
+            vmbreak;
         }
-        case OP_LOADNIL: {
+        vmcase(OP_LOADNIL) {
             TValue *rb = RB(i);
             do {
                 setnilvalue(rb--);
             } while (rb >= ra);
-            continue;
+            vmbreak;
         }
-        case OP_GETUPVAL: {
+        vmcase(OP_GETUPVAL) {
             int b = GETARG_B(i);
             setobj2s(L, ra, cl->upvals[b]->v);
-            continue;
-        }
-        case OP_GETGLOBAL: {
-            TValue g;
-            TValue *rb = KBx(i);
-            sethvalue(L, &g, cl->env);
-            Protect(luaV_gettable(L, &g, rb, ra));
-            continue;
-        }
-        case OP_GETTABLE: {
-            Protect(luaV_gettable(L, RB(i), RKC(i), ra));
-            continue;
-        }
-        case OP_SETGLOBAL: {
-            TValue g;
-            sethvalue(L, &g, cl->env);
-            Protect(luaV_settable(L, &g, KBx(i), ra));
-            continue;
-        }
-        case OP_SETUPVAL: {
+            vmbreak;
+        }
+        vmcase(OP_GETGLOBAL) getglobal_op(vmbreak)
+        vmcase(OP_GETTABLE) gettable_op(vmbreak)
+        vmcase(OP_SETGLOBAL) {
+            Table *h = cl->env;
+            TValue *v = cachedstr(h, rawtsvalue(KBx(i)), icslot());
+            if (v != nullptr && !v->isnil()) {
+                luaT_tablewrite(G(L), h);
+                setobj2t(L, v, ra);
+                luaC_barriert(L, h, ra);
+            } else {
+                TValue g;
+                sethvalue(L, &g, h);
+                Protect(luaV_settable(L, &g, KBx(i), ra));
+            }
+            vmbreak;
+        }
+        vmcase(OP_SETUPVAL) {
             UpVal *uv = cl->upvals[GETARG_B(i)];
             setobj(L, uv->v, ra);
             luaC_barrier(L, uv, ra);
-            continue;
-        }
-        case OP_SETTABLE: {
-            Protect(luaV_settable(L, ra, RKB(i), RKC(i)));
-            continue;
+            vmbreak;
         }
-        case OP_NEWTABLE: {
+        vmcase(OP_SETTABLE) settable_op(vmbreak)
+        vmcase(OP_NEWTABLE) {
             int b = GETARG_B(i);
             int c = GETARG_C(i);
-            sethvalue(L, ra, luaH_new(L, luaO_fb2int(b), luaO_fb2int(c)));
+            sethvalue(L, ra,
+                      luaH_newat(L, luaO_fb2int(b), luaO_fb2int(c), pc - 1));
             Protect(luaC_checkGC(L));
-            continue;
+            vmbreak;
         }
-        case OP_SELF: {
-            StkId rb = RB(i);
-            setobjs2s(L, ra + 1, rb);
-            Protect(luaV_gettable(L, rb, RKC(i), ra));
-            continue;
+        vmcase(OP_SELF) self_op(vmbreak)
+        vmcase(OP_ADD) {
+            arith_opq(luai_numadd, TM_ADD, OP_ADD_NN, OP_ADD_NK);
+            vmbreak;
         }
-        case OP_ADD: {
-            arith_op(luai_numadd, TM_ADD);
-            continue;
+        vmcase(OP_SUB) {
+            arith_opq(luai_numsub, TM_SUB, OP_SUB_NN, OP_SUB_NK);
+            vmbreak;
         }
-        case OP_SUB: {
-            arith_op(luai_numsub, TM_SUB);
-            continue;
+        vmcase(OP_MUL) {
+            arith_opq(luai_nummul, TM_MUL, OP_MUL_NN, OP_MUL_NK);
+            vmbreak;
         }
-        case OP_MUL: {
-            arith_op(luai_nummul, TM_MUL);
-            continue;
+        vmcase(OP_DIV) {
+            arith_opq(luai_numdiv, TM_DIV, OP_DIV_NN, OP_DIV_NK);
+            vmbreak;
         }
-        case OP_DIV: {
-            arith_op(luai_numdiv, TM_DIV);
-            continue;
-        }
-        case OP_MOD: {
+        vmcase(OP_MOD) {
             arith_op(luai_nummod, TM_MOD);
-            continue;
+            vmbreak;
         }
-        case OP_POW: {
+        vmcase(OP_POW) {
             arith_op(luai_numpow, TM_POW);
-            continue;
+            vmbreak;
         }
-        case OP_UNM: {
+        vmcase(OP_UNM) {
             TValue *rb = RB(i);
             if (rb->isnumber()) {
+#if LUA_INTSUBTYPE
+                if (ttisint(rb) && intarith(TM_UNM, ivalue(rb), 0, ra))
+                    vmbreak;
+#endif
                 lua_Number nb = nvalue(rb);
                 setnvalue(ra, luai_numunm(nb));
             } else {
                 Protect(Arith(L, ra, rb, rb, TM_UNM));
             }
-            continue;
+            vmbreak;
         }
-        case OP_NOT: {
+        vmcase(OP_NOT) {
             int res =
                 (RB(i))->isfalse(); /* next assignment may change this value */
             setbvalue(ra, res);
-            continue;
+            vmbreak;
         }
-        case OP_LEN: {
+        vmcase(OP_LEN) {
             const TValue *rb = RB(i);
             switch (ttype(rb)) {
             case LUA_TTABLE: {
-                setnvalue(ra, cast_num(luaH_getn(hvalue(rb))));
+                setivalue(ra, luaH_getn(hvalue(rb)));
                 break;
             }
             case LUA_TSTRING: {
-                setnvalue(ra, cast_num(tsvalue(rb)->len));
+                setivalue(ra, tsvalue(rb)->len);
                 break;
             }
             default: { /* try metamethod */
@@ -525,52 +1029,78 @@ reentry: /* entry point */
                             luaG_typeerror(L, rb, "get length of");)
             }
             }
-            continue;
+            vmbreak;
         }
-        case OP_CONCAT: {
+        vmcase(OP_CONCAT) {
             int b = GETARG_B(i);
             int c = GETARG_C(i);
             Protect(luaV_concat(L, c - b + 1, c); luaC_checkGC(L));
             setobjs2s(L, RA(i), base + b);
-            continue;
+            vmbreak;
         }
-        case OP_JMP: {
+        vmcase(OP_JMP) {
             dojump(L, pc, GETARG_sBx(i));
-            continue;
+            vmsafepoint();
+            if (GETARG_sBx(i) < 0)
+                nativeloop();
+            vmbreak;
         }
-        case OP_EQ: {
+        vmcase(OP_EQ) {
             TValue *rb = RKB(i);
             TValue *rc = RKC(i);
             Protect(if (equalobj(L, rb, rc) == GETARG_A(i))
                         dojump(L, pc, GETARG_sBx(*pc));) pc++;
-            continue;
+            vmsafepoint();
+            vmbreak;
         }
-        case OP_LT: {
-            Protect(if (luaV_lessthan(L, RKB(i), RKC(i)) == GETARG_A(i))
-                        dojump(L, pc, GETARG_sBx(*pc));) pc++;
-            continue;
+        vmcase(OP_LT) {
+            TValue *rb = RKB(i);
+            TValue *rc = RKC(i);
+            if (rb->isnumber() && rc->isnumber()) {
+                quicken(OP_LT_NN);
+                if (numlt(rb, rc) == GETARG_A(i))
+                    dojump(L, pc, GETARG_sBx(*pc));
+            } else {
+                Protect(if (luaV_lessthan(L, rb, rc) == GETARG_A(i))
+                            dojump(L, pc, GETARG_sBx(*pc)););
+            }
+            pc++;
+            vmsafepoint();
+            vmbreak;
         }
-        case OP_LE: {
-            Protect(if (lessequal(L, RKB(i), RKC(i)) == GETARG_A(i))
-                        dojump(L, pc, GETARG_sBx(*pc));) pc++;
-            continue;
+        vmcase(OP_LE) {
+            TValue *rb = RKB(i);
+            TValue *rc = RKC(i);
+            if (rb->isnumber() && rc->isnumber()) {
+                quicken(OP_LE_NN);
+                if (numle(rb, rc) == GETARG_A(i))
+                    dojump(L, pc, GETARG_sBx(*pc));
+            } else {
+                Protect(if (lessequal(L, rb, rc) == GETARG_A(i))
+                            dojump(L, pc, GETARG_sBx(*pc)););
+            }
+            pc++;
+            vmsafepoint();
+            vmbreak;
         }
-        case OP_TEST: {
+        vmcase(OP_TEST) {
             if ((ra)->isfalse() != GETARG_C(i))
                 dojump(L, pc, GETARG_sBx(*pc));
             pc++;
-            continue;
+            vmsafepoint();
+            vmbreak;
         }
-        case OP_TESTSET: {
+        vmcase(OP_TESTSET) {
             TValue *rb = RB(i);
             if ((rb)->isfalse() != GETARG_C(i)) {
                 setobjs2s(L, ra, rb);
                 dojump(L, pc, GETARG_sBx(*pc));
             }
             pc++;
-            continue;
+            vmsafepoint();
+            vmbreak;
         }
-        case OP_CALL: {
+        vmcase(OP_CALL) {
             int b = GETARG_B(i);
             int nresults = GETARG_C(i) - 1;
             if (b != 0)
@@ -586,14 +1116,15 @@ reentry: /* entry point */
                 if (nresults >= 0)
                     L->top = L->ci->top;
                 base = L->base;
-                continue;
+                vmsafepoint();
+                vmbreak;
             }
             default: {
-                return; /* yield */
+                return 0; /* yield */
             }
             }
         }
-        case OP_TAILCALL: {
+        vmcase(OP_TAILCALL) {
             int b = GETARG_B(i);
             if (b != 0)
                 L->top = ra + b; /* else previous instruction set top */
@@ -618,14 +1149,15 @@ reentry: /* entry point */
             }
             case PCRC: { /* it was a C function (`precall' called it) */
                 base = L->base;
-                continue;
+                vmsafepoint();
+                vmbreak;
             }
             default: {
-                return; /* yield */
+                return 0; /* yield */
             }
             }
         }
-        case OP_RETURN: {
+        vmcase(OP_RETURN) {
             int b = GETARG_B(i);
             if (b != 0)
                 L->top = ra + b - 1;
@@ -634,14 +1166,29 @@ reentry: /* entry point */
             L->savedpc = pc;
             b = luaD_poscall(L, ra);
             if (--nexeccalls == 0) /* was previous function running `here'? */
-                return;            /* no: return */
+                return 0;            /* no: return */
             else {                 /* yes: continue its execution */
                 if (b)
                     L->top = L->ci->top;
                 goto reentry;
             }
         }
-        case OP_FORLOOP: {
+        vmcase(OP_FORLOOP) {
+#if LUA_INTSUBTYPE
+            if (ttisint(ra)) { /* integer loop? */
+                l_int64 step = ivalue(ra + 2);
+                l_int64 idx;
+                if (luaO_intadd(ivalue(ra), step, &idx) && /* overflow ends */
+                    (0 < step ? idx <= ivalue(ra + 1)
+                              : ivalue(ra + 1) <= idx)) {
+                    dojump(L, pc, GETARG_sBx(i));
+                    setivalue(ra, idx);
+                    setivalue(ra + 3, idx);
+                }
+                vmsafepoint();
+                vmbreak;
+            }
+#endif
             lua_Number step = nvalue(ra + 2);
             lua_Number idx =
                 luai_numadd(nvalue(ra), step); /* increment index */
@@ -651,27 +1198,63 @@ reentry: /* entry point */
                 dojump(L, pc, GETARG_sBx(i)); /* jump back */
                 setnvalue(ra, idx);           /* update internal index... */
                 setnvalue(ra + 3, idx);       /* ...and external index */
+                vmsafepoint();
+                nativeloop();
+                vmbreak;
             }
-            continue;
+            vmsafepoint();
+            vmbreak;
         }
-        case OP_FORPREP: {
+        vmcase(OP_FORPREP) {
             const TValue *init = ra;
             const TValue *plimit = ra + 1;
             const TValue *pstep = ra + 2;
             L->savedpc = pc; /* next steps may throw errors */
-            if (!tonumber(init, ra))
+            if (!tonumber(L, init, ra))
                 luaG_runerror(L,
                               LUA_QL("for") " initial value must be a number");
-            else if (!tonumber(plimit, ra + 1))
+            else if (!tonumber(L, plimit, ra + 1))
                 luaG_runerror(L, LUA_QL("for") " limit must be a number");
-            else if (!tonumber(pstep, ra + 2))
+            else if (!tonumber(L, pstep, ra + 2))
                 luaG_runerror(L, LUA_QL("for") " step must be a number");
+#if LUA_INTSUBTYPE
+            l_int64 init0;
+            if (ttisint(init) && ttisint(pstep) &&
+                forlimit(ra + 1, ivalue(pstep)) &&
+                luaO_intsub(ivalue(init), ivalue(pstep), &init0)) {
+                setivalue(ra, init0);
+                dojump(L, pc, GETARG_sBx(i));
+                vmbreak;
+            }
+#endif
             setnvalue(ra, luai_numsub(nvalue(ra), nvalue(pstep)));
             dojump(L, pc, GETARG_sBx(i));
-            continue;
+            vmbreak;
         }
-        case OP_TFORLOOP: {
+        vmcase(OP_TFORLOOP) {
             StkId cb = ra + 3; /* call base */
+            if (iscfunction(ra) && clvalue(ra)->c.f == G(L)->nextf &&
+                (ra + 1)->istable() && /* `next' over a table? do it here */
+                !(L->hookmask & (LUA_MASKCALL | LUA_MASKRET))) {
+                /* key and value; a loop with one variable has no slot for
+                   the value */
+                TValue kv[2];
+                StkId res = (GETARG_C(i) >= 2) ? cb : kv;
+                setobjs2s(L, res, ra + 2);
+                int more;
+                Protect(more = luaH_next(L, hvalue(ra + 1), res));
+                if (more) {
+                    if (res == kv)
+                        setobjs2s(L, cb, kv);
+                    for (int v = 2; v < GETARG_C(i); v++)
+                        setnilvalue(cb + v);
+                    setobjs2s(L, cb - 1, cb);       /* save control variable */
+                    dojump(L, pc, GETARG_sBx(*pc)); /* jump back */
+                }
+                pc++;
+                vmsafepoint();
+                vmbreak;
+            }
             setobjs2s(L, cb + 2, ra + 2);
             setobjs2s(L, cb + 1, ra + 1);
             setobjs2s(L, cb, ra);
@@ -684,9 +1267,10 @@ reentry: /* entry point */
                 dojump(L, pc, GETARG_sBx(*pc)); /* jump back */
             }
             pc++;
-            continue;
+            vmsafepoint();
+            vmbreak;
         }
-        case OP_SETLIST: {
+        vmcase(OP_SETLIST) {
             int n = GETARG_B(i);
             int c = GETARG_C(i);
             int last;
@@ -703,17 +1287,17 @@ reentry: /* entry point */
             if (last > h->sizearray)          /* needs more space? */
                 luaH_resizearray(L, h, last); /* pre-alloc it at once */
             for (; n > 0; n--) {
-                TValue *val = ra + n;
-                setobj2t(L, luaH_setnum(L, h, last--), val);
-                luaC_barriert(L, h, val);
+                TValue idx;
+                setivalue(&idx, last--);
+                luaH_setobj(L, h, &idx, ra + n);
             }
-            continue;
+            vmbreak;
         }
-        case OP_CLOSE: {
+        vmcase(OP_CLOSE) {
             luaF_close(L, ra);
-            continue;
+            vmbreak;
         }
-        case OP_CLOSURE: {
+        vmcase(OP_CLOSURE) {
             Proto *p;
             Closure *ncl;
             int nup, j;
@@ -730,9 +1314,9 @@ reentry: /* entry point */
             }
             setclvalue(L, ra, ncl);
             Protect(luaC_checkGC(L));
-            continue;
+            vmbreak;
         }
-        case OP_VARARG: {
+        vmcase(OP_VARARG) {
             int b = GETARG_B(i) - 1;
             CallInfo *ci = L->ci;
             int n = cast_int(ci->base - ci->func) - cl->p->numparams - 1;
@@ -749,8 +1333,89 @@ reentry: /* entry point */
                     setnilvalue(ra + j);
                 }
             }
-            continue;
+            vmbreak;
         }
+        vmcase(OP_ADD_NN) {
+            arith_nn(luai_numadd, TM_ADD, OP_ADD);
+            vmbreak;
         }
+        vmcase(OP_SUB_NN) {
+            arith_nn(luai_numsub, TM_SUB, OP_SUB);
+            vmbreak;
+        }
+        vmcase(OP_MUL_NN) {
+            arith_nn(luai_nummul, TM_MUL, OP_MUL);
+            vmbreak;
+        }
+        vmcase(OP_DIV_NN) {
+            arith_nn(luai_numdiv, TM_DIV, OP_DIV);
+            vmbreak;
+        }
+        vmcase(OP_ADD_NK) {
+            arith_nk(luai_numadd, TM_ADD, OP_ADD);
+            vmbreak;
+        }
+        vmcase(OP_SUB_NK) {
+            arith_nk(luai_numsub, TM_SUB, OP_SUB);
+            vmbreak;
+        }
+        vmcase(OP_MUL_NK) {
+            arith_nk(luai_nummul, TM_MUL, OP_MUL);
+            vmbreak;
+        }
+        vmcase(OP_DIV_NK) {
+            arith_nk(luai_numdiv, TM_DIV, OP_DIV);
+            vmbreak;
+        }
+        vmcase(OP_LT_NN) {
+            TValue *rb = RKB(i);
+            TValue *rc = RKC(i);
+            if (rb->isnumber() && rc->isnumber()) {
+                if (numlt(rb, rc) == GETARG_A(i))
+                    dojump(L, pc, GETARG_sBx(*pc));
+            } else {
+                quicken(OP_LT);
+                Protect(if (luaV_lessthan(L, rb, rc) == GETARG_A(i))
+                            dojump(L, pc, GETARG_sBx(*pc)););
+            }
+            pc++;
+            vmsafepoint();
+            vmbreak;
+        }
+        vmcase(OP_LE_NN) {
+            TValue *rb = RKB(i);
+            TValue *rc = RKC(i);
+            if (rb->isnumber() && rc->isnumber()) {
+                if (numle(rb, rc) == GETARG_A(i))
+                    dojump(L, pc, GETARG_sBx(*pc));
+            } else {
+                quicken(OP_LE);
+                Protect(if (lessequal(L, rb, rc) == GETARG_A(i))
+                            dojump(L, pc, GETARG_sBx(*pc)););
+            }
+            pc++;
+            vmsafepoint();
+            vmbreak;
+        }
+        vmcase(OP_GETTABLE_GETTABLE) gettable_op(vmnext(OP_GETTABLE))
+        vmcase(OP_GETTABLE_CALL) gettable_op(vmnext(OP_CALL))
+        vmcase(OP_GETGLOBAL_GETTABLE) getglobal_op(vmnext(OP_GETTABLE))
+        vmcase(OP_SETTABLE_FORLOOP) settable_op(vmnext(OP_FORLOOP))
+        vmcase(OP_SELF_CALL) self_op(vmnext(OP_CALL))
+        vmcase(OP_MOVE_CALL) {
+            setobjs2s(L, ra, RB(i));
+            vmnext(OP_CALL);
+        }
+        }
+    }
+}
+#if LUA_USE_JUMPTABLE && defined(__GNUC__)
+#pragma GCC diagnostic pop /* see `ljumptab.h' */
+#endif
+
+void luaV_execute(lua_State *L, int nexeccalls) {
+    while (hasinstrhook(L) ? execute<true>(L, &nexeccalls)
+                           : execute<false>(L, &nexeccalls)) {
+        /* hooks were set or cleared: continue in the other variant */
     }
 }
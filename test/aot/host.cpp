@@ -0,0 +1,34 @@
+/*
+** runs module MODULE, compiled by luaot and linked in, through `require':
+** c++ -DMODULE=name host.cpp name.cpp liblua.a
+*/
+
+#include <cstdio>
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lualib.h"
+
+#define PRELOAD(m) PRELOAD_(m)
+#define PRELOAD_(m) luaot_preload_##m
+
+void PRELOAD(MODULE)(lua_State *L);
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s module\n", argv[0]);
+        return 1;
+    }
+    lua_State *L = luaL_newstate();
+    luaL_openlibs(L);
+    PRELOAD(MODULE)(L);
+    lua_getglobal(L, "require");
+    lua_pushstring(L, argv[1]);
+    if (lua_pcall(L, 1, 0, 0) != 0) {
+        fprintf(stderr, "%s\n", lua_tostring(L, -1));
+        return 1;
+    }
+    lua_close(L);
+    return 0;
+}
@@ -0,0 +1,11 @@
+-- recursive calls and small-integer arithmetic
+local function fib(n)
+    if n < 2 then
+        return n
+    end
+    return fib(n - 1) + fib(n - 2)
+end
+
+local t = os.clock()
+local r = fib(35)
+print("fib", os.clock() - t, r)
@@ -0,0 +1,7 @@
+-- numeric for loop with arithmetic on locals
+local t = os.clock()
+local s = 0
+for i = 1, 30000000 do
+    s = s + i * 2 - 1
+end
+print("loop", os.clock() - t, s)
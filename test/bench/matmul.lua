@@ -0,0 +1,19 @@
+-- dense matrix product with array indexing in the inner loop
+local t = os.clock()
+local n = 200
+local a, b, c = {}, {}, {}
+for i = 1, n do
+    local ra, rb = {}, {}
+    for j = 1, n do ra[j] = i + j; rb[j] = i - j end
+    a[i], b[i] = ra, rb
+end
+for i = 1, n do
+    local ra, rc = a[i], {}
+    for j = 1, n do
+        local s = 0
+        for k = 1, n do s = s + ra[k] * b[k][j] end
+        rc[j] = s
+    end
+    c[i] = rc
+end
+print("matmul", os.clock() - t, c[n][n])
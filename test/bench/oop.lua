@@ -0,0 +1,18 @@
+-- method calls resolved through a three-level `__index' chain
+local Base = {}
+Base.__index = Base
+function Base:get()
+    return self.v
+end
+local Mid = setmetatable({}, Base)
+Mid.__index = Mid
+local Leaf = setmetatable({}, Mid)
+Leaf.__index = Leaf
+local o = setmetatable({v = 1}, Leaf)
+
+local t = os.clock()
+local s = 0
+for i = 1, 5000000 do
+    s = s + o:get()
+end
+print("oop", os.clock() - t, s)
@@ -0,0 +1,14 @@
+#!/bin/sh
+# best of N runs of each benchmark: run.sh [lua] [N] [names...]
+cd "$(dirname "$0")"
+LUA=${1:-../../lua}
+N=${2:-5}
+[ $# -gt 2 ] && shift 2 || set -- fib loop tab oop str buf sieve mandel matmul
+for f in "$@"; do
+    best=
+    for k in $(seq "$N"); do
+        v=$("$LUA" "$f.lua" | awk '{print $2}')
+        best=$(echo "$v ${best:-$v}" | awk '{print ($1 < $2) ? $1 : $2}')
+    done
+    printf "%-8s %s\n" "$f" "$best"
+done
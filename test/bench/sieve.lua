@@ -0,0 +1,15 @@
+-- sieve of Eratosthenes over a boolean array
+local t = os.clock()
+local n = 0
+for r = 1, 30 do
+    local flags = {}
+    for i = 2, 100000 do flags[i] = true end
+    n = 0
+    for i = 2, 100000 do
+        if flags[i] then
+            n = n + 1
+            for j = i + i, 100000, i do flags[j] = false end
+        end
+    end
+end
+print("sieve", os.clock() - t, n)
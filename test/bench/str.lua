@@ -0,0 +1,20 @@
+-- tostring, table.concat, gmatch, string keys and repeated `..'
+local t = os.clock()
+local parts = {}
+for i = 1, 200000 do
+    parts[#parts + 1] = tostring(i)
+end
+local s = table.concat(parts, ",")
+local n = 0
+for w in s:gmatch("%d+") do
+    n = n + 1
+end
+local h = {}
+for i = 1, 200000 do
+    h["k" .. i] = i
+end
+local acc = ""
+for i = 1, 20000 do
+    acc = acc .. "x"
+end
+print("str", os.clock() - t, n, #acc)
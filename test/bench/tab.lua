@@ -0,0 +1,17 @@
+-- array stores and loads, then string-keyed field updates
+local t = os.clock()
+local a = {}
+for i = 1, 2000000 do
+    a[i] = i
+end
+local s = 0
+for r = 1, 10 do
+    for i = 1, #a do
+        s = s + a[i]
+    end
+end
+local p = {x = 1, y = 2, z = 3}
+for i = 1, 5000000 do
+    p.x = p.x + p.y * p.z
+end
+print("tab", os.clock() - t, s, p.x)
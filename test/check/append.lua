@@ -0,0 +1,91 @@
+-- `s = s .. x' may append to a long string in place: no other string
+-- that shares its characters may see the change
+
+local base = string.rep("a", 45)
+
+-- older strings keep their contents after later appends
+local s = base
+local hist = {}
+for i = 1, 2000 do
+  s = s .. i .. ","
+  if i % 97 == 0 then hist[#hist + 1] = s end
+end
+for _, h in ipairs(hist) do
+  assert(s:sub(1, #h) == h and #h < #s and h:sub(-1) == ",")
+end
+
+-- aliases of the string being extended
+local a = base .. "0"
+local alias = a
+a = a .. "1"
+assert(alias == base .. "0" and a == base .. "01")
+local b1 = alias .. "X" -- `alias' no longer ends its buffer
+local b2 = a .. "Y"
+assert(b1 == base .. "0X" and b2 == base .. "01Y" and a == base .. "01")
+
+-- two strings extended from the same one
+local p = base .. "p"
+local q1 = p .. "1"
+local q2 = p .. "2"
+assert(q1 == base .. "p1" and q2 == base .. "p2" and p == base .. "p")
+local q3 = q1 .. "3"
+assert(q1 == base .. "p1" and q3 == base .. "p13" and q2 == base .. "p2")
+
+-- a string appended to itself
+local y = string.rep("c", 50)
+y = y .. y
+assert(y == string.rep("c", 100))
+y = y .. y .. y
+assert(y == string.rep("c", 300))
+
+-- in table fields and upvalues
+local t = {base}
+for i = 1, 100 do t[1] = t[1] .. "z" end
+assert(t[1] == base .. string.rep("z", 100))
+local up = base
+local function add(x) up = up .. x; return up end
+local r1 = add("1")
+local r2 = add("2")
+assert(r1 == base .. "1" and r2 == base .. "12" and up == r2)
+
+-- keys and equality with strings built otherwise
+local k = {}
+k[hist[5]] = 1
+local copy = base
+for i = 1, 97 * 5 do copy = copy .. i .. "," end
+assert(copy == hist[5] and k[copy] == 1 and rawequal(copy, hist[5]))
+
+-- conversions and comparisons read a terminated string
+local n = string.rep("1", 42)
+local m = n .. "5"
+local m2 = m .. "7"
+assert(tonumber(m) == tonumber(string.rep("1", 42) .. "5"))
+assert(m + 0 == tonumber(m) and m < m2 and not (m2 < m))
+local x = string.rep("b", 41)
+local x1 = x .. "\0z"
+local x2 = x1 .. "q"
+assert(x1 < x2 and #x1 == 43 and x1:byte(42) == 0)
+assert(#tostring(hist[2]) == #hist[2])
+assert(string.format("%s", hist[1]) == hist[1])
+assert(select(2, hist[4]:gsub(",", ",")) == 97 * 4)
+local mode = string.rep(" ", 41)
+local mk = mode .. "k"
+local w = setmetatable({}, {__mode = mk})
+w[{}] = 1
+collectgarbage()
+assert(next(w) == nil)
+local mode2 = mode .. "v" -- after `mk' was read
+assert(mode2 == string.rep(" ", 41) .. "v" and mk:sub(-1) == "k")
+
+-- strings that outlive the ones they were extended from
+local keep = {}
+local g = base
+for i = 1, 300 do
+  g = g .. string.char(65 + i % 26)
+  if i % 50 == 0 then keep[#keep + 1] = g; collectgarbage() end
+end
+g = nil
+collectgarbage()
+for i, h in ipairs(keep) do assert(#h == 45 + 50 * i) end
+
+print("OK")
@@ -0,0 +1,81 @@
+-- results of `luaL_Buffer': up to LUAI_MAXSHORTLEN (40) bytes they are
+-- interned strings, above it the buffer block itself becomes the string
+
+local S = 40
+
+-- short results are interned: equal strings compare by address
+for n = 0, S do
+  local lit = string.rep("a", n)
+  assert(table.concat({lit}) == lit)
+  assert(("x"):rep(n):gsub("x", "a") == lit)
+  assert(string.format("%s", lit) == lit)
+  local parts = {}
+  for i = 1, n do parts[i] = "a" end
+  local r = table.concat(parts)
+  assert(r == lit and #r == n)
+  local k = {}
+  k[lit] = true
+  assert(k[r])
+end
+
+-- just above it, and the results stay usable as keys and in appends
+for n = S + 1, S + 3 do
+  local parts = {}
+  for i = 1, n do parts[i] = "b" end
+  local r = table.concat(parts)
+  assert(#r == n and r == string.rep("b", n))
+  local k = {[r] = 1}
+  assert(k[string.rep("b", n)] == 1)
+  local r2 = r .. "!"
+  assert(#r2 == n + 1 and r2:sub(1, n) == r and r == string.rep("b", n))
+end
+
+-- around sizes the buffer inside `luaL_Buffer' (LUAL_BUFFERSIZE) may have,
+-- where the characters move to a block on the heap
+for _, size in ipairs{255, 256, 257, 511, 512, 513, 1023, 1024, 1025,
+                      4095, 4096, 4097, 8191, 8192, 8193, 16385} do
+  local s = string.rep("c", size)
+  assert(#table.concat({s}) == size)
+  assert(table.concat({s, "d"}) == s .. "d")
+  local r = s:gsub("c", "c")
+  assert(r == s)
+end
+
+-- `luaL_addvalue' adds values from the stack, the block sits below them
+local t = {}
+for i = 1, 100000 do t[i] = "item" .. i end
+local s = table.concat(t, ",")
+local n = 0
+for w in s:gmatch("[^,]+") do n = n + 1; assert(w == "item" .. n) end
+assert(n == 100000)
+local r = string.rep("ab", 100000)
+local g2, k = r:gsub("b", function (c) return c:upper() .. "!" end)
+assert(k == 100000 and #g2 == 300000 and g2:sub(1, 6) == "aB!aB!")
+local big = string.rep("v", 20000)
+local g3 = ("x_x"):gsub("_", function () return big end)
+assert(#g3 == 20002 and g3 == "x" .. big .. "x")
+local g4 = ("_"):rep(5):gsub("_", {["_"] = big})
+assert(#g4 == 100000)
+local tc = table.concat({big, 1, big, 2.5}, "|")
+assert(tc == big .. "|1|" .. big .. "|2.5")
+
+-- errors while the block is on the heap
+assert(not pcall(string.gsub, r, "a", function () error("boom") end))
+assert(not pcall(table.concat, {string.rep("q", 9000), {}}))
+
+-- io reads through the same buffers
+local name = os.tmpname()
+local h = io.open(name, "w")
+h:write(string.rep("L", 30000), "\n", "short\n", string.rep("S", S), "\n",
+        string.rep("M", 9000))
+h:close()
+h = io.open(name)
+local l1, l2, l3, l4 = h:read("*l", "*l", "*l", "*a")
+h:close()
+os.remove(name)
+assert(#l1 == 30000 and l2 == "short" and l3 == string.rep("S", S))
+assert(#l4 == 9000)
+
+collectgarbage()
+collectgarbage()
+print("OK")
@@ -0,0 +1,81 @@
+-- table.clone: a shallow copy without the metatable
+
+local function same(a, b)
+  local n = 0
+  for k, v in pairs(a) do
+    assert(rawequal(b[k], v) or (v ~= v and b[k] ~= b[k]))
+    n = n + 1
+  end
+  for k in pairs(b) do n = n - 1 end
+  assert(n == 0)
+end
+
+local t = {1, 2, 3, "x", a = 1, b = {}, [1.5] = true, [100] = 7}
+local c = table.clone(t)
+same(t, c)
+c.a = 2; c[1] = 9; c.new = 1
+assert(t.a == 1 and t[1] == 1 and t.new == nil)
+assert(#c == #t)
+assert(c.b == t.b) -- shallow
+assert(next(table.clone({})) == nil)
+assert(not pcall(table.clone, 1))
+
+-- packed array parts
+local p = {}
+for i = 1, 1000 do p[i] = i * 0.25 end
+local pc = table.clone(p)
+same(p, pc)
+pc[5] = "s"
+assert(p[5] == 1.25 and #pc == 1000)
+p[1000] = nil
+assert(#p == 999 and #pc == 1000)
+
+-- the metatable stays behind
+local m = setmetatable({x = 1}, {__index = function () return 1 end})
+local mc = table.clone(m)
+assert(getmetatable(mc) == nil and mc.y == nil and mc.x == 1)
+
+-- deleted keys, and growth of the copy
+local d = {}
+for i = 1, 100 do d["k" .. i] = {} end
+for i = 1, 50 do d["k" .. i] = nil end
+collectgarbage()
+local dc = table.clone(d)
+same(d, dc)
+for i = 1, 200 do dc["z" .. i] = i end
+for i = 51, 100 do assert(dc["k" .. i] == d["k" .. i]) end
+assert(d.z1 == nil)
+
+-- cloned in the middle of an incremental resize (they happen at 4097 and
+-- 8193 keys), then both grown on past its end
+for _, n in ipairs{4097, 4097 + 300, 8193, 8193 + 1, 8193 + 500} do
+  local g = {}
+  for i = 1, n do g["k" .. i] = i; g[-i] = i end
+  local gc = table.clone(g)
+  same(g, gc)
+  for i = n + 1, n + 2000 do g["k" .. i] = i end
+  for i = 1, n, 2 do gc[-i] = nil end
+  for i = 1, n + 2000 do assert(g["k" .. i] == i) end
+  for i = 1, n do
+    assert(gc["k" .. i] == i and g[-i] == i)
+    assert(gc[-i] == (i % 2 == 0 and i or nil))
+  end
+  assert(gc["k" .. (n + 1)] == nil)
+  collectgarbage()
+  local c2 = table.clone(gc)
+  same(gc, c2)
+end
+
+-- weak tables: the copy holds its keys strongly
+local w = setmetatable({}, {__mode = "k"})
+for i = 1, 10 do w[{}] = i end
+local wc = table.clone(w)
+collectgarbage()
+local n = 0
+for k, v in pairs(wc) do n = n + 1; assert(w[k] == v) end
+assert(n == 10)
+wc = nil
+collectgarbage()
+assert(next(w) == nil)
+
+print("OK")
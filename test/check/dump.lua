@@ -0,0 +1,69 @@
+-- string.dump/load round-trips of quickened and fused code
+
+local function roundtrip(f)
+  return assert(loadstring(string.dump(f)))
+end
+
+local function work(n)
+  local t = {x = {y = 1}}
+  local obj = {v = 0}
+  function obj:inc(d) self.v = self.v + d end
+  local acc, f = 0, 0.5
+  for i = 1, n do
+    acc = acc + i * 2 - 1       -- arithmetic on registers and constants
+    f = f / 2 + i * f
+    if acc < i or i <= 0 then acc = 0 end
+    t[i] = t.x.y + i            -- chained gets, set in a loop
+    obj:inc(1)                  -- self and call
+    local g = math.floor
+    acc = g(acc)
+  end
+  return acc, f, #t, obj.v
+end
+
+local function same(a, b)
+  local r1 = {a(100)}
+  local r2 = {b(100)}
+  assert(#r1 == #r2)
+  for i = 1, #r1 do assert(r1[i] == r2[i]) end
+end
+
+-- dumped before and after the opcodes were specialized
+local before = roundtrip(work)
+work(200)
+local after = roundtrip(work)
+same(work, before)
+same(work, after)
+-- loaded code is fused on load: dump it again
+local again = roundtrip(after)
+after(100)
+same(work, roundtrip(again))
+assert(string.dump(before) == string.dump(after))
+assert(string.dump(again) == string.dump(work))
+
+-- table constructors whose SETLIST block number needs a count word
+-- (above 511 * 50 items); the count words take every value of the low
+-- opcode bits, so none may be taken for a quickened opcode
+local N = 30000
+local parts = {}
+for i = 1, N do parts[i] = tostring(i) end
+local src = "return function () return {" .. table.concat(parts, ",") .. "} end"
+local mk = assert(loadstring(src))()
+for _, f in ipairs{mk, roundtrip(mk), roundtrip(roundtrip(mk))} do
+  local t = f()
+  assert(#t == N)
+  for i = 1, N, 97 do assert(t[i] == i) end
+  assert(t[N] == N)
+end
+
+-- a quickened loop over such a table survives the round-trip too
+local function sum(t)
+  local s = 0
+  for i = 1, #t do s = s + t[i] end
+  return s
+end
+local big = mk()
+assert(sum(big) == N * (N + 1) / 2)
+assert(roundtrip(sum)(big) == N * (N + 1) / 2)
+
+print("OK")
@@ -0,0 +1,47 @@
+-- stores that compiled code does without the interpreter must drop the
+-- cached absence of metamethods like any other store. Each loop body
+-- calls nothing before its last line: compiled code leaves at calls.
+
+local assert = assert
+local function f(_, k) return k end
+
+-- into an existing field with a nil value
+local mt = {__index = f}
+local t = setmetatable({}, mt)
+for i = 1, 200 do
+  mt.__index = nil
+  local a = t.x
+  mt.__index = f
+  local b = t.x
+  assert(a == nil and b == "x")
+end
+
+-- the same through globals
+local env = {__index = f}
+local g = setmetatable({}, env)
+local loop = setfenv(function (f)
+  for i = 1, 200 do
+    __index = nil
+    local a = g.y
+    __index = f
+    local b = g.y
+    assert(a == nil and b == "y")
+  end
+end, env)
+loop(f)
+
+-- `__newindex' set in a field that was nil
+local n = 0
+local function count() n = n + 1 end
+local nmt = {__newindex = count}
+local u = setmetatable({}, nmt)
+for i = 1, 200 do
+  nmt.__newindex = nil
+  u.z = i
+  u.z = nil
+  nmt.__newindex = count
+  u.z = i
+  assert(rawget(u, "z") == nil and n == i)
+end
+
+print("OK")
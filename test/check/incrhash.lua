@@ -0,0 +1,103 @@
+-- hash parts above LUAI_INCRHASH nodes grow incrementally: after a resize
+-- the old part is moved a few nodes per insertion. Each size below stops
+-- in the middle of such a move (resizes happen at 4097 and 8193 keys).
+
+local sizes = {4097, 4097 + 100, 8193, 8193 + 1, 8193 + 200, 8193 + 1000,
+               8193 + 1100}
+
+local function key(kind, i)
+  if kind == 1 then return "k" .. i
+  elseif kind == 2 then return i + 0.5
+  else return -i end
+end
+
+local function fill(kind, n)
+  local t = {}
+  for i = 1, n do t[key(kind, i)] = i end
+  return t
+end
+
+local function check(t, kind, n, skip)
+  local seen, c = {}, 0
+  for k, v in pairs(t) do
+    assert(not seen[k], "key visited twice")
+    seen[k] = true
+    c = c + 1
+    assert(t[k] == v)
+  end
+  for i = 1, n do
+    local v = t[key(kind, i)]
+    if skip and skip(i) then assert(v == nil) else assert(v == i) end
+  end
+  return c
+end
+
+for kind = 1, 3 do
+  for _, n in ipairs(sizes) do
+    local t = fill(kind, n)
+    assert(check(t, kind, n) == n)
+
+    -- change and delete fields while traversing
+    local c = 0
+    for k, v in pairs(t) do
+      c = c + 1
+      if v % 3 == 0 then t[k] = nil else t[k] = v end
+    end
+    assert(c == n)
+    local gone = function (i) return i % 3 == 0 end
+    assert(check(t, kind, n, gone) == n - math.floor(n / 3))
+
+    -- growing on after the deletions finishes the move
+    for i = n + 1, n + 2000 do t[key(kind, i)] = i end
+    for i = 1, n + 2000 do
+      local v = t[key(kind, i)]
+      if i <= n and gone(i) then assert(v == nil) else assert(v == i) end
+    end
+
+    -- clearing everything while traversing
+    for k in pairs(t) do t[k] = nil end
+    assert(next(t) == nil)
+  end
+end
+
+-- integer keys of a move in progress may land in the array part
+for _, n in ipairs(sizes) do
+  local t = {}
+  for i = n, 1, -1 do t[i] = i end
+  for i = 1, n do assert(t[i] == i) end
+  assert(#t == n)
+  local c = 0
+  for k, v in pairs(t) do c = c + 1; assert(k == v) end
+  assert(c == n)
+end
+
+-- weak tables collected in the middle of a move
+for _, n in ipairs(sizes) do
+  local wk = setmetatable({}, {__mode = "k"})
+  local wv = setmetatable({}, {__mode = "v"})
+  local keep = {}
+  for i = 1, n do
+    local o = {}
+    if i % 4 == 0 then keep[#keep + 1] = o end
+    wk[o] = i
+    wv["v" .. i] = o
+  end
+  collectgarbage()
+  collectgarbage()
+  local c = 0
+  for k, v in pairs(wk) do c = c + 1; assert(v % 4 == 0) end
+  assert(c == #keep)
+  c = 0
+  for k, v in pairs(wv) do c = c + 1; assert(wk[v] == tonumber(k:sub(2))) end
+  assert(c == #keep)
+  for i = 1, #keep do assert(wk[keep[i]] == i * 4) end
+  -- and collected while they are being traversed
+  c = 0
+  for k in pairs(wv) do
+    c = c + 1
+    collectgarbage("step")
+  end
+  assert(c == #keep)
+end
+
+print("OK")
@@ -0,0 +1,93 @@
+-- `__index' chains of tables are resolved through a cache: every result
+-- must be the one a plain walk of the chain would give
+
+local function walk(o, k)
+  while true do
+    local v = rawget(o, k)
+    if v ~= nil then return v end
+    local mt = getmetatable(o)
+    local h = mt and rawget(mt, "__index")
+    if h == nil then return nil end
+    if type(h) == "function" then return h(o, k) end
+    o = h
+  end
+end
+
+local keys = {"name", "kind", "size", "extra", "missing"}
+
+local function check(objs)
+  for r = 1, 3 do -- the first round fills the cache, the others hit it
+    for _, o in ipairs(objs) do
+      for _, k in ipairs(keys) do assert(o[k] == walk(o, k)) end
+      assert(o.name == walk(o, "name")) -- constant keys
+      assert(o.kind == walk(o, "kind"))
+    end
+  end
+end
+
+local Base = {name = "base", kind = "base"}
+local A = setmetatable({kind = "a"}, {__index = Base})
+local B = setmetatable({}, {__index = Base})
+local amt, bmt = {__index = A}, {__index = B}
+local a, b = setmetatable({}, amt), setmetatable({}, bmt)
+local objs = {a, b}
+check(objs)
+
+-- writes at every level of the chain
+Base.name = "base2"; check(objs)
+A.name = "a"; check(objs)
+rawset(A, "name", nil); check(objs)
+A.kind = nil; check(objs)
+B.size = 1; check(objs)
+Base.size = 2; check(objs)
+B.size = nil; check(objs)
+a.name = "own"; check(objs)
+a.name = nil; check(objs)
+
+-- tables written after their entries were dropped, and written again
+-- after being read
+A.extra = 0; check(objs)
+A.extra = 1; A.extra = 2; check(objs)
+B.extra = 3; check(objs)
+A.extra = nil; B.extra = nil; check(objs)
+
+-- through the table library, table.clear and many string keys at once
+table.insert(A, 1); check(objs)
+table.clear(Base); check(objs)
+Base.name, Base.kind = "b3", "b3"; check(objs)
+for i = 1, 1000 do B["k" .. i] = i end
+check(objs)
+for i = 1, 1000 do assert(b["k" .. i] == i and a["k" .. i] == nil) end
+
+-- changing metatables and `__index' fields in the chain
+setmetatable(B, {__index = {name = "other", size = 7}}); check(objs)
+setmetatable(B, nil); check(objs)
+amt.__index = B; check(objs)
+amt.__index = function (_, k) return k .. "!" end; check(objs)
+amt.__index = A; check(objs)
+setmetatable(a, bmt); check(objs)
+setmetatable(a, amt); check(objs)
+getmetatable(A).__index = nil; check(objs)
+getmetatable(A).__index = Base; check(objs)
+
+-- metatables shared by many objects, and collections flushing the cache
+local many = {}
+for i = 1, 100 do many[i] = setmetatable({}, i % 2 == 0 and amt or bmt) end
+check(many)
+collectgarbage()
+check(many)
+Base.kind = "last"; check(many)
+
+-- method calls in a loop, with the class changing part way
+local Class = {}
+Class.__index = Class
+function Class:get() return self.v end
+local obj = setmetatable({v = 1}, Class)
+local sum = 0
+for i = 1, 200 do
+  sum = sum + obj:get()
+  if i == 100 then function Class:get() return self.v * 2 end end
+end
+assert(sum == 100 + 200)
+
+print("OK")
@@ -0,0 +1,84 @@
+-- `#t' remembers the last border it found; appends and pops move it
+
+local function border(t, n)
+  return (n == 0 or t[n] ~= nil) and t[n + 1] == nil
+end
+
+-- proper sequences: the border is unique
+local t = {}
+for i = 1, 1000 do
+  t[#t + 1] = i
+  assert(#t == i)
+end
+for i = 1000, 1, -1 do
+  assert(#t == i)
+  t[#t] = nil
+end
+assert(#t == 0)
+
+-- through the table library and with rawset
+for i = 1, 300 do table.insert(t, i) end
+assert(#t == 300)
+for i = 1, 100 do assert(table.remove(t) == 301 - i) end
+assert(#t == 200)
+table.insert(t, 1, 0)
+assert(#t == 201 and t[1] == 0 and t[201] == 200)
+table.remove(t, 1)
+assert(#t == 200 and t[1] == 1)
+rawset(t, 201, 201)
+assert(#t == 201)
+rawset(t, 201, nil)
+assert(#t == 200)
+
+-- appends past the array part, into the hash part and back
+t = {}
+for i = 1, 64 do t[i] = i end
+t[66] = 66
+assert(#t == 64 or #t == 66)
+t[65] = 65
+assert(#t == 66)
+t[66], t[65] = nil, nil
+assert(#t == 64)
+
+-- the hint must not outlive the elements it was found with
+t = {1, 2, 3, 4, 5, 6, 7, 8}
+assert(#t == 8)
+for i = 8, 1, -1 do t[i] = nil end
+assert(#t == 0)
+t[1] = "a"
+assert(#t == 1)
+t = {n = 1}
+for i = 1, 10 do t[i] = i end
+assert(#t == 10)
+t[5] = nil
+assert(border(t, #t))
+t[10] = nil
+assert(border(t, #t))
+
+-- non-numbers in a packed array
+t = {}
+for i = 1, 100 do t[i] = i end
+assert(#t == 100)
+t[101] = "x"
+assert(#t == 101)
+t[101] = nil
+t[100] = false
+assert(#t == 100)
+
+-- random appends, pops, holes and other keys
+math.randomseed(7)
+for trial = 1, 200 do
+  t = {}
+  for step = 1, 300 do
+    local r = math.random()
+    local n = #t
+    if r < 0.5 then t[n + 1] = step
+    elseif r < 0.7 then t[n] = nil
+    elseif r < 0.8 then t[math.random(1, 400)] = step
+    elseif r < 0.9 then t[math.random(1, 400)] = nil
+    else t["s" .. step] = "x" end
+    assert(border(t, #t))
+  end
+end
+
+print("OK")
@@ -0,0 +1,123 @@
+-- `next' first tries the node of the key it returned last
+
+local function count(t)
+  local n = 0
+  for _ in pairs(t) do n = n + 1 end
+  return n
+end
+
+local t = {}
+for i = 1, 1000 do t["k" .. i] = i; t[i] = i end
+t[2000] = true
+local n, s = 0, 0
+for k, v in pairs(t) do
+  n = n + 1
+  if type(v) == "number" then s = s + v end
+end
+assert(n == 2001 and s == 2 * 500500)
+
+-- deleting the key just returned, and others, while traversing
+n = 0
+for k, v in pairs(t) do
+  n = n + 1
+  t[k] = nil
+  if type(k) == "string" and n % 2 == 0 then t["k" .. (v % 1000 + 1)] = nil end
+end
+assert(next(t) == nil and n > 1000)
+
+-- deleted keys stay valid arguments to `next', also after a collection
+t = {}
+for i = 1, 200 do t["x" .. i] = {} end
+local k = next(t)
+t[k] = nil
+collectgarbage()
+local seen = 1
+while true do
+  k = next(t, k)
+  if k == nil then break end
+  seen = seen + 1
+  t[k] = nil
+end
+assert(seen == 200 and next(t) == nil)
+
+-- keys that are not the last one returned
+t = {a = 1, b = 2, c = 3, d = 4, e = 5}
+local order = {}
+for k in pairs(t) do order[#order + 1] = k end
+for i = #order - 1, 1, -1 do assert(next(t, order[i]) == order[i + 1]) end
+for i = 1, #order - 1 do assert(next(t, order[i]) == order[i + 1]) end
+assert(next(t, order[#order]) == nil)
+
+-- two traversals of one table interleaved
+local cnt = 0
+for k1 in pairs(t) do
+  for k2 in pairs(t) do cnt = cnt + 1 end
+end
+assert(cnt == 25)
+local k1, k2 = next(t), next(t)
+local c1, c2 = 0, 0
+while k1 or k2 do
+  if k1 then c1 = c1 + 1; k1 = next(t, k1) end
+  if k2 then c2 = c2 + 1; k2 = next(t, k2) end
+end
+assert(c1 == 5 and c2 == 5)
+
+-- a remembered node beyond a hash part that has shrunk
+t = {}
+for i = 1, 5000 do t["s" .. i] = i end
+for k in pairs(t) do end
+for k in pairs(t) do if k ~= "s1" then t[k] = nil end end
+for i = 1, 20000 do t[-i] = i; t[-i] = nil end -- until a rehash shrinks it
+for i = 1, 9 do t[i + 0.5] = i end
+assert(count(t) == 10)
+k = nil
+for i = 1, 10 do k = next(t, k); assert(k ~= nil) end
+assert(next(t, k) == nil)
+
+-- collected weak keys in the middle of a traversal
+local wk = setmetatable({}, {__mode = "k"})
+local keep = {}
+for i = 1, 100 do
+  local o = {}
+  wk[o] = i
+  if i % 2 == 0 then keep[#keep + 1] = o end
+end
+n = 0
+for k, v in pairs(wk) do
+  n = n + 1
+  if n == 30 then collectgarbage() end
+end
+assert(n > 50 and n < 100)
+collectgarbage() -- the key held by the loop at the first one
+assert(count(wk) == 50)
+
+-- loops with one variable, also as the last register of a function
+local function keys(tt)
+  local c = 0
+  for k in pairs(tt) do c = c + 1 end
+  return c
+end
+t = {}
+for i = 1, 10 do t[i] = i; t["k" .. i] = i end
+assert(keys(t) == 20)
+n = 0
+for k in next, t do n = n + t[k] end
+assert(n == 110)
+
+-- call hooks see every call of `next' that a loop makes
+local pnext = pairs({})
+local calls = 0
+debug.sethook(function ()
+  if debug.getinfo(2, "f").func == pnext then calls = calls + 1 end
+end, "c")
+for k in pairs({a = 1, b = 2}) do end
+for k, v in pairs({a = 1, b = 2}) do end
+debug.sethook()
+assert(calls == 6)
+
+-- invalid keys
+assert(not pcall(next, {}, "nope"))
+local ok, e = pcall(function () for k in next, {a = 1}, "zz" do end end)
+assert(not ok and e:find("invalid key"))
+
+print("OK")
@@ -0,0 +1,78 @@
+-- quickened arithmetic and comparisons must go back to the generic
+-- opcodes when their operands stop being numbers
+
+local function arith(a, b)
+  return a + b, a - b, a * b, a / b
+end
+
+local function arithk(a)
+  return a + 2, a - 2, a * 2, a / 2
+end
+
+local function lt(a, b) return a < b end
+local function le(a, b) return a <= b end
+
+-- warm up with numbers so the opcodes specialize
+for i = 1, 100 do
+  local s, d, m, q = arith(i, 4)
+  assert(s == i + 4 and d == i - 4 and m == i * 4 and q == i / 4)
+  s, d, m, q = arithk(i)
+  assert(s == i + 2 and d == i - 2 and m == i * 2 and q == i / 2)
+  assert(lt(i, i + 1) and not lt(i + 1, i))
+  assert(le(i, i) and not le(i + 1, i))
+end
+
+-- operands with metamethods
+local mt = {}
+mt.__add = function (a, b) return "add" end
+mt.__sub = function (a, b) return "sub" end
+mt.__mul = function (a, b) return "mul" end
+mt.__div = function (a, b) return "div" end
+mt.__lt = function (a, b) return rawget(a, 1) < rawget(b, 1) end
+mt.__le = function (a, b) return rawget(a, 1) <= rawget(b, 1) end
+local x, y = setmetatable({1}, mt), setmetatable({2}, mt)
+
+local s, d, m, q = arith(x, 3)
+assert(s == "add" and d == "sub" and m == "mul" and q == "div")
+s, d, m, q = arith(3, y)
+assert(s == "add" and d == "sub" and m == "mul" and q == "div")
+s, d, m, q = arithk(x)
+assert(s == "add" and d == "sub" and m == "mul" and q == "div")
+assert(lt(x, y) and not lt(y, x))
+assert(le(x, x) and not le(y, x))
+
+-- numeric strings are coerced, other strings compare as strings
+s, d, m, q = arith("10", "4")
+assert(s == 14 and d == 6 and m == 40 and q == 2.5)
+s, d, m, q = arithk("10")
+assert(s == 12 and d == 8 and m == 20 and q == 5)
+assert(lt("a", "b") and not lt("b", "a"))
+assert(le("a", "a") and not le("b", "a"))
+
+-- mixed operands still raise errors
+assert(not pcall(arith, 1, {}))
+assert(not pcall(arithk, {}))
+assert(not pcall(lt, 1, "x"))
+assert(not pcall(le, {}, {}))
+
+-- and the opcodes specialize again afterwards
+for i = 1, 100 do
+  local s, d, m, q = arith(i, 4)
+  assert(s == i + 4 and d == i - 4 and m == i * 4 and q == i / 4)
+  s, d, m, q = arithk(i)
+  assert(s == i + 2 and d == i - 2 and m == i * 2 and q == i / 2)
+  assert(lt(i, i + 1) and le(i, i))
+end
+
+-- a loop whose operands change type half way through
+local function sum(t)
+  local acc = 0
+  for i = 1, #t do acc = acc + t[i] end
+  return acc
+end
+assert(sum({1, 2, 3, 4}) == 10)
+local n = setmetatable({}, {__add = function (a, b) return 100 end})
+assert(sum({1, 2, n, 4}) == 104)
+assert(sum({1, 2, 3}) == 6)
+
+print("OK")
@@ -0,0 +1,46 @@
+-- strings are hashed on all their bytes: keys that differ in one byte
+-- anywhere must spread over a hash part
+
+local function spread(t, n)
+  local nkeys, probes, longest = debug.hashstats(t)
+  assert(nkeys == n)
+  assert(probes / nkeys < 2 and longest < 32)
+end
+
+-- one varying byte at every position of strings around the length
+-- where strings stop being interned
+for _, len in ipairs{1, 7, 8, 9, 16, 39, 40, 41, 64, 65, 300} do
+  for pos = 1, len, (len > 64) and 37 or 1 do
+    local t, n = {}, 0
+    local pre, post = string.rep("x", pos - 1), string.rep("y", len - pos)
+    for c = 0, 255 do
+      local s = pre .. string.char(c) .. post
+      assert(#s == len)
+      t[s] = c
+      n = n + 1
+    end
+    for c = 0, 255 do
+      local s = pre .. string.char(c) .. post
+      assert(t[s] == c)
+    end
+    spread(t, n)
+  end
+end
+
+-- many strings with a long common prefix and suffix
+for _, len in ipairs{8, 24, 40, 640} do
+  local t = {}
+  local pre, post = string.rep("x", len), string.rep("y", len)
+  for i = 1, 20000 do t[pre .. string.format("%05d", i) .. post] = i end
+  for i = 1, 20000 do assert(t[pre .. string.format("%05d", i) .. post] == i) end
+  spread(t, 20000)
+end
+
+-- embedded zeros take part in the hash and in equality
+local z = {}
+for i = 1, 100 do z[string.rep("\0", i)] = i end
+for i = 1, 100 do assert(z[string.rep("\0", i)] == i) end
+assert(("a\0b") ~= ("a\0c") and ("a\0b") == ("a\0" .. "b"))
+spread(z, 100)
+
+print("OK")
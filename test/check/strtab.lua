@@ -0,0 +1,48 @@
+-- short strings are interned: equal ones must be the same object, also
+-- while the intern table grows or shrinks (it moves a few strings per new
+-- string) and after tombstones of collected ones pile up
+
+local function mk(i, r) return "k" .. i .. "_" .. r end
+
+-- grow: strings created during a move compare equal to those made before
+local t, keep = {}, {}
+for i = 1, 100000 do
+  local s = mk(i, 0)
+  t[s] = i
+  if i % 7 == 0 then keep[#keep + 1] = s end
+  if i % 1000 == 0 then
+    for j = i - 999, i, 97 do assert(t[mk(j, 0)] == j) end
+  end
+end
+for i = 1, 100000, 13 do assert(t[mk(i, 0)] == i) end
+
+-- shrink: collections halve the table while most strings die
+t = nil
+for r = 1, 6 do
+  collectgarbage()
+  for i = 1, #keep, 101 do
+    local s = keep[i]
+    assert(s == mk(s:match("^k(%d+)"), 0))
+  end
+end
+local u = {}
+for i = 1, #keep do u[keep[i]] = i end
+for i = 1, #keep, 37 do assert(u[mk(i * 7, 0)] == i) end
+keep, u = nil, nil
+collectgarbage()
+collectgarbage()
+
+-- many short-lived strings: dead slots get reused or swept
+for r = 1, 20 do
+  local tmp = {}
+  for i = 1, 5000 do tmp[i] = mk(i, r) end
+  for i = 1, 5000, 11 do assert(tmp[i] == mk(i, r)) end
+  if r % 3 == 0 then collectgarbage() end
+end
+
+-- reserved words and names survive all of it
+local f = assert(loadstring("local function while_() return 'end' end return while_()"))
+assert(f() == "end")
+assert(("x" .. 1) == ("x" .. "1"))
+
+print("OK")
@@ -0,0 +1,77 @@
+-- table.new preallocates; table.clear empties a table for reuse
+
+local function count(t)
+  local n = 0
+  for _ in pairs(t) do n = n + 1 end
+  return n
+end
+
+local t = table.new(100, 10)
+assert(type(t) == "table" and next(t) == nil and #t == 0)
+for i = 1, 100 do t[i] = i end
+for i = 1, 10 do t["k" .. i] = i end
+assert(#t == 100 and count(t) == 110)
+assert(next(table.new()) == nil and next(table.new(0, 0)) == nil)
+assert(next(table.new(1000)) == nil and #table.new(1000) == 0)
+assert(not pcall(table.new, -1))
+assert(not pcall(table.new, 0, -1))
+
+-- clear keeps the table and its metatable
+local mt = {}
+setmetatable(t, mt)
+table.clear(t)
+assert(next(t) == nil and #t == 0 and t.k1 == nil and t[1] == nil)
+assert(getmetatable(t) == mt)
+for i = 1, 100 do t[i] = tostring(i) end
+t.x = 1
+assert(#t == 100 and t[50] == "50" and t.x == 1 and count(t) == 101)
+table.clear(t)
+assert(next(t) == nil)
+assert(not pcall(table.clear, 1))
+table.clear({})
+
+-- numbers, then other values, in the array part
+local a = table.new(64)
+for r = 1, 3 do
+  for i = 1, 64 do a[i] = (r == 2) and {} or i * 0.5 end
+  assert(#a == 64)
+  table.clear(a)
+  assert(#a == 0 and a[1] == nil and a[64] == nil)
+end
+
+-- cached `__index' resolutions through a cleared table
+local base = {f = 1}
+local obj = setmetatable({}, {__index = base})
+for i = 1, 3 do assert(obj.f == 1) end
+table.clear(base)
+assert(obj.f == nil)
+base.f = 2
+assert(obj.f == 2)
+
+-- cleared in the middle of an incremental resize
+local g = {}
+for i = 1, 8193 + 100 do g["k" .. i] = i end
+table.clear(g)
+assert(next(g) == nil and g.k1 == nil and g.k8293 == nil)
+for i = 1, 1000 do g["z" .. i] = i end
+assert(count(g) == 1000 and g.z1000 == 1000)
+
+-- weak tables
+local w = setmetatable({}, {__mode = "k"})
+for i = 1, 100 do w[{}] = i end
+table.clear(w)
+assert(next(w) == nil)
+local keep = {}
+w[keep] = 1
+collectgarbage()
+assert(w[keep] == 1 and count(w) == 1)
+
+-- a table reused in a loop
+local s = table.new(0, 4)
+for r = 1, 1000 do
+  table.clear(s)
+  s.a, s.b, s.c, s.d = r, r, r, r
+  assert(count(s) == 4 and s.a == r)
+end
+
+print("OK")